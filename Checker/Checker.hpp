@@ -5,8 +5,10 @@
 #include <vector>
 #include <functional>
 #include <stdexcept>
+#include <exception>
 #include <iostream>
 #include "../Container/Container.hpp"
+#include "PlaceStatus.hpp"
 
 
 class Storage;
@@ -15,8 +17,11 @@ template <typename T>
 class Checker {
 public:
     using CheckFunction = std::function<void(Storage&, std::shared_ptr<IContainer>, ContainerPosition<T>)>;
+    // Проверка без исключений: возвращает причину отказа
+    using StatusFunction = std::function<PlaceStatus(Storage&, std::shared_ptr<IContainer>, ContainerPosition<T>)>;
 private:
     std::vector<CheckFunction> checkFunctions;
+    std::vector<StatusFunction> statusFunctions;
 
 public:
 
@@ -25,12 +30,18 @@ public:
     Checker() = default;
 
     Checker(const Checker& other)
-        : checkFunctions(other.checkFunctions) {}
+        : checkFunctions(other.checkFunctions), statusFunctions(other.statusFunctions) {}
+
+    Checker& operator=(const Checker& other) = default;
         
     void addCheckFunction(CheckFunction func) {
         checkFunctions.push_back(func);
     }
 
+    void addStatusFunction(StatusFunction func) {
+        statusFunctions.push_back(func);
+    }
+
     
     void removeCheckFunction(size_t index) {
         if (index >= checkFunctions.size()) {
@@ -40,7 +51,36 @@ public:
     }
 
     
+    // Сначала проверки с кодами, затем внешние функции. Исключение из внешней
+    // функции превращается в PlaceStatus::Rejected, само оно сохраняется в rejection.
+    PlaceStatus check(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position, std::exception_ptr* rejection = nullptr) const {
+        for (const auto& func : statusFunctions) {
+            PlaceStatus status = func(storage, container, position);
+            if (status != PlaceStatus::Ok) {
+                return status;
+            }
+        }
+        for (const auto& func : checkFunctions) {
+            try {
+                func(storage, container, position);
+            } catch (const std::exception&) {
+                if (rejection != nullptr) {
+                    *rejection = std::current_exception();
+                }
+                return PlaceStatus::Rejected;
+            }
+        }
+        return PlaceStatus::Ok;
+    }
+
+
     void applyChecks(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position) const {
+        for (const auto& func : statusFunctions) {
+            PlaceStatus status = func(storage, container, position);
+            if (status != PlaceStatus::Ok) {
+                throw std::invalid_argument(placeStatusMessage(status));
+            }
+        }
         for (const auto& func : checkFunctions) {
             func(storage, container, position);
         }
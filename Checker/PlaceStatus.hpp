@@ -0,0 +1,51 @@
+#ifndef PLACESTATUS_HPP
+#define PLACESTATUS_HPP
+
+
+#include <string>
+
+
+// Результат пробы размещения. Поиск места перебирает много кандидатов,
+// поэтому отказ возвращается кодом, а исключение бросают только публичные обёртки.
+enum class PlaceStatus{
+    Ok,
+    InvalidCoordinates,
+    InvalidContainer,
+    NoPlace,
+    TooHot,
+    CantFly,
+    NoSupport,
+    TooHeavy,
+    Rejected,
+    Cancelled
+};
+
+
+inline std::string placeStatusMessage(PlaceStatus status){
+    switch(status){
+        case PlaceStatus::Ok:
+            return "Ok";
+        case PlaceStatus::InvalidCoordinates:
+            return "Coordinates should be positive";
+        case PlaceStatus::InvalidContainer:
+            return "Container is null";
+        case PlaceStatus::NoPlace:
+            return "Valid place for container doesn t exist";
+        case PlaceStatus::TooHot:
+            return "Container is too hot";
+        case PlaceStatus::CantFly:
+            return "Container can t fly 1";
+        case PlaceStatus::NoSupport:
+            return "Support doesn t exist";
+        case PlaceStatus::TooHeavy:
+            return "Container would be too heavy";
+        case PlaceStatus::Rejected:
+            return "Container rejected by external check";
+        case PlaceStatus::Cancelled:
+            return "Placement cancelled";
+    }
+    return "Unknown placement status";
+}
+
+
+#endif
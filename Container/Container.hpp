@@ -12,6 +12,7 @@
 class Container: public IContainer{
     protected:
         std::string number;                      
+        ContainerId key;
         std::string client;              
         int length, width, height;       
         double cost;                     
@@ -40,7 +41,11 @@ class Container: public IContainer{
         }
 
         std::string getId() const override{
-            return number;
+            return key.valid() ? key.toString() : number;
+        }
+
+        ContainerId getKey() const override{
+            return key;
         }
 
         double getMass() const override{
@@ -48,34 +53,44 @@ class Container: public IContainer{
         }
 
         void setId(int X, int Y, int Z) override{
-            number = std::to_string(X) + "_" + std::to_string(Y) + "_" + std::to_string(Z);
+            key = ContainerId(X, Y, Z);
         }
 
     void getInfo(std::ostream& output) const override{
-        output << "Container ID: " << number << std::endl;
+        output << "Container ID: " << getId() << std::endl;
         output << "Client: " << client << std::endl;
         output << "Dimensions: " << length << "x" << width << "x" << height << std::endl;
         output << "Cost: $" << cost << std::endl;
         output << "Mass: " << mass << " kg" << std::endl;
     };
     std::shared_ptr<IContainer> Clone(size_t i = 0, size_t method = 0) override{
+        std::shared_ptr<Container> clone;
         switch (method)
         {
         case 0:
-            return std::make_shared<Container>(number, client, length, width, height, cost, mass);
+            clone = std::make_shared<Container>(number, client, length, width, height, cost, mass);
+            break;
         case 1:
-            return std::make_shared<Container>(number, client, width, length, height, cost, mass);
+            clone = std::make_shared<Container>(number, client, width, length, height, cost, mass);
+            break;
         case 2:
-            return std::make_shared<Container>(number, client, length, height, width, cost, mass);
+            clone = std::make_shared<Container>(number, client, length, height, width, cost, mass);
+            break;
         case 3:
-            return std::make_shared<Container>(number, client, height, length, width, cost, mass);
+            clone = std::make_shared<Container>(number, client, height, length, width, cost, mass);
+            break;
         case 4:
-            return std::make_shared<Container>(number, client, width, height, length, cost, mass);
+            clone = std::make_shared<Container>(number, client, width, height, length, cost, mass);
+            break;
         case 5:
-            return std::make_shared<Container>(number, client, height, width, length, cost, mass);
+            clone = std::make_shared<Container>(number, client, height, width, length, cost, mass);
+            break;
         default:
-            return std::make_shared<Container>(number, client, length, width, height, cost, mass);
+            clone = std::make_shared<Container>(number, client, length, width, height, cost, mass);
+            break;
         }
+        clone->key = key;
+        return clone;
     }
 
     std::string isType() const override{
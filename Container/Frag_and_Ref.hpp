@@ -9,6 +9,7 @@
 class FragileRefragedContainer : public IFragileContainer , public IRefragedContainer{
     protected:
         std::string number;                      
+        ContainerId key;
         std::string client;              
         int length, width, height;       
         double cost;                     
@@ -40,13 +41,17 @@ class FragileRefragedContainer : public IFragileContainer , public IRefragedCont
         }
 
         std::string getId() const override{
-            return number;
+            return key.valid() ? key.toString() : number;
+        }
+
+        ContainerId getKey() const override{
+            return key;
         }
 
 
 
         void setId(int X, int Y, int Z) override{
-            number = std::to_string(X) + "_" + std::to_string(Y) + "_" + std::to_string(Z);
+            key = ContainerId(X, Y, Z);
         }
 
         double getMass() const override{
@@ -54,7 +59,7 @@ class FragileRefragedContainer : public IFragileContainer , public IRefragedCont
         }
 
     void getInfo(std::ostream& output) const override{
-        output << "Container ID: " << number << std::endl;
+        output << "Container ID: " << getId() << std::endl;
         output << "Client: " << client << std::endl;
         output << "Dimensions: " << length << "x" << width << "x" << height << std::endl;
         output << "Cost: $" << cost << std::endl;
@@ -65,23 +70,33 @@ class FragileRefragedContainer : public IFragileContainer , public IRefragedCont
         double getMaxPressure() const override{ return maxPressure; }
         double getMaxTemperature() const override{ return maxTemperature; }
         std::shared_ptr<IContainer> Clone(size_t i = 0, size_t method = 0) override{ 
+            std::shared_ptr<FragileRefragedContainer> clone;
             switch (method)
             {
             case 0:
-                return std::make_shared<FragileRefragedContainer>(number, client, length, width, height, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, length, width, height, cost, mass,  maxPressure, maxTemperature);
+                break;
             case 1:
-                return std::make_shared<FragileRefragedContainer>(number, client, width, length, height, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, width, length, height, cost, mass,  maxPressure, maxTemperature);
+                break;
             case 2:
-                return std::make_shared<FragileRefragedContainer>(number, client, length, height, width, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, length, height, width, cost, mass,  maxPressure, maxTemperature);
+                break;
             case 3:
-                return std::make_shared<FragileRefragedContainer>(number, client, height, length, width, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, height, length, width, cost, mass,  maxPressure, maxTemperature);
+                break;
             case 4:
-                return std::make_shared<FragileRefragedContainer>(number, client, width, height, length, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, width, height, length, cost, mass,  maxPressure, maxTemperature);
+                break;
             case 5:
-                return std::make_shared<FragileRefragedContainer>(number, client, height, width, length, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, height, width, length, cost, mass,  maxPressure, maxTemperature);
+                break;
             default:
-                return std::make_shared<FragileRefragedContainer>(number, client, length, width, height, cost, mass,  maxPressure, maxTemperature);
+                clone = std::make_shared<FragileRefragedContainer>(number, client, length, width, height, cost, mass,  maxPressure, maxTemperature);
+                break;
             }
+            clone->key = key;
+            return clone;
         }
         ~FragileRefragedContainer() override{}
 };
@@ -7,6 +7,7 @@
 class FragileContainer : public IFragileContainer{
     protected:
         std::string number;                      
+        ContainerId key;
         std::string client;              
         int length, width, height;       
         double cost;                     
@@ -37,12 +38,16 @@ class FragileContainer : public IFragileContainer{
         }
 
         std::string getId() const override{
-            return number;
+            return key.valid() ? key.toString() : number;
+        }
+
+        ContainerId getKey() const override{
+            return key;
         }
 
 
         void setId(int X, int Y, int Z) override{
-            number = std::to_string(X) + "_" + std::to_string(Y) + "_" + std::to_string(Z);
+            key = ContainerId(X, Y, Z);
         }
 
 
@@ -51,7 +56,7 @@ class FragileContainer : public IFragileContainer{
         }
 
     void getInfo(std::ostream& output) const override{
-        output << "Container ID: " << number << std::endl;
+        output << "Container ID: " << getId() << std::endl;
         output << "Client: " << client << std::endl;
         output << "Dimensions: " << length << "x" << width << "x" << height << std::endl;
         output << "Cost: $" << cost << std::endl;
@@ -64,23 +69,33 @@ class FragileContainer : public IFragileContainer{
         double getMaxPressure() const override{ return maxPressure; }
 
         std::shared_ptr<IContainer> Clone(size_t i = 0, size_t method = 0) override { 
+            std::shared_ptr<FragileContainer> clone;
             switch (method)
             {
             case 0:
-                return std::make_shared<FragileContainer>(number, client, length, width, height, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, length, width, height, cost, mass, maxPressure);
+                break;
             case 1:
-                return std::make_shared<FragileContainer>(number, client, width, length, height, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, width, length, height, cost, mass, maxPressure);
+                break;
             case 2:
-                return std::make_shared<FragileContainer>(number, client, length, height, width, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, length, height, width, cost, mass, maxPressure);
+                break;
             case 3:
-                return std::make_shared<FragileContainer>(number, client, height, length, width, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, height, length, width, cost, mass, maxPressure);
+                break;
             case 4:
-                return std::make_shared<FragileContainer>(number, client, width, height, length, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, width, height, length, cost, mass, maxPressure);
+                break;
             case 5:
-                return std::make_shared<FragileContainer>(number, client, height, width, length, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, height, width, length, cost, mass, maxPressure);
+                break;
             default:
-                return std::make_shared<FragileContainer>(number, client, length, width, height, cost, mass, maxPressure);
+                clone = std::make_shared<FragileContainer>(number, client, length, width, height, cost, mass, maxPressure);
+                break;
             }
+            clone->key = key;
+            return clone;
         }
 };
 
@@ -0,0 +1,110 @@
+#ifndef CONTAINERID_HPP
+#define CONTAINERID_HPP
+
+
+#include <cstdint>
+#include <string>
+#include <charconv>
+#include <stdexcept>
+#include <functional>
+
+
+// Идентификатор контейнера - координаты его нижнего угла (X, Y, Z),
+// упакованные по 21 биту в одно 64-битное число. Строка "X_Y_Z"
+// получается из него только на границе API (getId, вывод информации).
+class ContainerId{
+    public:
+        static constexpr int Bits = 21;
+        static constexpr uint64_t Mask = (uint64_t(1) << Bits) - 1;
+        static constexpr int MaxCoordinate = static_cast<int>(Mask);
+
+    private:
+        static constexpr uint64_t InvalidValue = ~uint64_t(0);
+        uint64_t value = InvalidValue;
+
+        static uint64_t checked(int c){
+            if(c < 0 || c > MaxCoordinate){
+                throw std::out_of_range("Container coordinate does not fit into ContainerId");
+            }
+            return static_cast<uint64_t>(c);
+        }
+
+    public:
+        constexpr ContainerId() = default;
+
+        ContainerId(int X, int Y, int Z)
+            : value((checked(X) << (2 * Bits)) | (checked(Y) << Bits) | checked(Z)) {}
+
+        int getX() const{
+            return static_cast<int>((value >> (2 * Bits)) & Mask);
+        }
+
+        int getY() const{
+            return static_cast<int>((value >> Bits) & Mask);
+        }
+
+        int getZ() const{
+            return static_cast<int>(value & Mask);
+        }
+
+        uint64_t raw() const{
+            return value;
+        }
+
+        bool valid() const{
+            return value != InvalidValue;
+        }
+
+        std::string toString() const{
+            if(!valid()){
+                return "_";
+            }
+            return std::to_string(getX()) + "_" + std::to_string(getY()) + "_" + std::to_string(getZ());
+        }
+
+        static ContainerId parse(const std::string& str){
+            int coords[3];
+            const char* first = str.data();
+            const char* last = str.data() + str.size();
+            for(int i = 0; i < 3; ++i){
+                auto [ptr, ec] = std::from_chars(first, last, coords[i]);
+                if(ec != std::errc() || ptr == first || coords[i] < 0 || coords[i] > MaxCoordinate){
+                    throw std::invalid_argument("Invalid container id " + str);
+                }
+                first = ptr;
+                if(i < 2){
+                    if(first == last || *first != '_'){
+                        throw std::invalid_argument("Invalid container id " + str);
+                    }
+                    ++first;
+                }
+            }
+            if(first != last){
+                throw std::invalid_argument("Invalid container id " + str);
+            }
+            return ContainerId(coords[0], coords[1], coords[2]);
+        }
+
+        bool operator==(const ContainerId& other) const{
+            return value == other.value;
+        }
+
+        bool operator!=(const ContainerId& other) const{
+            return value != other.value;
+        }
+
+        bool operator<(const ContainerId& other) const{
+            return value < other.value;
+        }
+};
+
+
+template <>
+struct std::hash<ContainerId>{
+    size_t operator()(const ContainerId& id) const noexcept{
+        return std::hash<uint64_t>()(id.raw());
+    }
+};
+
+
+#endif
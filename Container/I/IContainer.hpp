@@ -6,6 +6,7 @@
 #include <vector>
 #include <iostream>
 #include <memory>
+#include "ContainerId.hpp"
 
 
 
@@ -15,6 +16,7 @@ public:
     virtual void getInfo(std::ostream& output) const = 0;
     virtual void setId(int X, int Y, int Z) = 0;
     virtual std::string getId() const = 0;
+    virtual ContainerId getKey() const = 0;
     virtual int getLength() const = 0;
     virtual int getWidth() const = 0;
     virtual int getHeight() const = 0;
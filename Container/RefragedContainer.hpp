@@ -8,6 +8,7 @@
 class RefragedContainer : public IRefragedContainer{
     protected:
         std::string number;                      
+        ContainerId key;
         std::string client;              
         int length, width, height;       
         double cost;                     
@@ -38,11 +39,15 @@ class RefragedContainer : public IRefragedContainer{
         }
 
         std::string getId() const override{
-            return number;
+            return key.valid() ? key.toString() : number;
+        }
+
+        ContainerId getKey() const override{
+            return key;
         }
 
         void setId(int X, int Y, int Z) override{
-            number = std::to_string(X) + "_" + std::to_string(Y) + "_" + std::to_string(Z);
+            key = ContainerId(X, Y, Z);
         }
 
         double getMass() const override{
@@ -50,7 +55,7 @@ class RefragedContainer : public IRefragedContainer{
         }
 
     void getInfo(std::ostream& output) const override{
-        output << "Container ID: " << number << std::endl;
+        output << "Container ID: " << getId() << std::endl;
         output << "Client: " << client << std::endl;
         output << "Dimensions: " << length << "x" << width << "x" << height << std::endl;
         output << "Cost: $" << cost << std::endl;
@@ -64,23 +69,33 @@ class RefragedContainer : public IRefragedContainer{
         return maxTemperature;
     }
     std::shared_ptr<IContainer> Clone(size_t i = 0, size_t method = 0) override {
+        std::shared_ptr<RefragedContainer> clone;
         switch (method)
         {
         case 0:
-            return std::make_shared<RefragedContainer>(number, client, length, width, height, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, length, width, height, cost, mass, maxTemperature);
+            break;
         case 1:
-            return std::make_shared<RefragedContainer>(number, client, width, length, height, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, width, length, height, cost, mass, maxTemperature);
+            break;
         case 2:
-            return std::make_shared<RefragedContainer>(number, client, length, height, width, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, length, height, width, cost, mass, maxTemperature);
+            break;
         case 3:
-            return std::make_shared<RefragedContainer>(number, client, height, length, width, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, height, length, width, cost, mass, maxTemperature);
+            break;
         case 4:
-            return std::make_shared<RefragedContainer>(number, client, width, height, length, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, width, height, length, cost, mass, maxTemperature);
+            break;
         case 5:
-            return std::make_shared<RefragedContainer>(number, client, height, width, length, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, height, width, length, cost, mass, maxTemperature);
+            break;
         default:
-            return std::make_shared<RefragedContainer>(number, client, length, width, height, cost, mass, maxTemperature);
+            clone = std::make_shared<RefragedContainer>(number, client, length, width, height, cost, mass, maxTemperature);
+            break;
         }
+        clone->key = key;
+        return clone;
     }
 };
 
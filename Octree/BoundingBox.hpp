@@ -0,0 +1,52 @@
+#ifndef BOUNDINGBOX_HPP
+#define BOUNDINGBOX_HPP
+
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+#include "Point.hpp"
+
+
+template<typename T>
+concept NumericConcept = std::is_arithmetic_v<T> || std::convertible_to<T, double>;
+
+
+template<typename T>
+concept PointConcept = requires(T a) {
+    { a.x } -> NumericConcept;
+    { a.y } -> NumericConcept;
+    { a.z } -> NumericConcept;
+    
+    { a == std::declval<T>() } -> std::same_as<bool>;
+    { a < std::declval<T>() } -> std::same_as<bool>;
+};
+
+
+template<typename T>
+concept BoundingBoxConcept = PointConcept<Point<T>>;
+
+template <typename T>
+requires BoundingBoxConcept<T>
+struct BoundingBox{
+    Point<T> min, max;
+    BoundingBox(const Point<T>& m, const Point<T>& ma) : min(m), max(ma) {}
+
+    bool contains(const Point<T>& p) const {
+        return min.x < p.x && p.x < max.x && min.y < p.y && p.y < max.y && min.z < p.z && p.z < max.z;
+    }
+
+    // Строгое вложение всего бокса: все 8 углов лежат внутри
+    bool contains(const BoundingBox& other) const {
+        return contains(other.min) && contains(other.max);
+    }
+
+    bool intersects(const BoundingBox& other) const {
+        return (max.x >= other.min.x && min.x <= other.max.x) &&
+                (max.y >= other.min.y && min.y <= other.max.y) &&
+                (max.z >= other.min.z && min.z <= other.max.z);
+    }
+};
+
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef ENTRYLIST_HPP
+#define ENTRYLIST_HPP
+
+
+#include <vector>
+#include <cstddef>
+#include "BoundingBox.hpp"
+
+
+// Содержимое узла октодерева в виде structure-of-arrays: шесть координат
+// габарита контейнера и сам контейнер лежат в отдельных непрерывных массивах.
+// Удаление переставляет последний элемент на место удалённого, порядок не сохраняется.
+template <typename T, typename N>
+struct EntryList{
+    std::vector<T> minX, minY, minZ;
+    std::vector<T> maxX, maxY, maxZ;
+    std::vector<N> items;
+
+    size_t size() const{
+        return items.size();
+    }
+
+    bool empty() const{
+        return items.empty();
+    }
+
+    void push_back(const BoundingBox<T>& box, N item){
+        minX.push_back(box.min.x);
+        minY.push_back(box.min.y);
+        minZ.push_back(box.min.z);
+        maxX.push_back(box.max.x);
+        maxY.push_back(box.max.y);
+        maxZ.push_back(box.max.z);
+        items.push_back(std::move(item));
+    }
+
+    BoundingBox<T> box(size_t i) const{
+        return BoundingBox<T>(Point<T>(minX[i], minY[i], minZ[i]), Point<T>(maxX[i], maxY[i], maxZ[i]));
+    }
+
+    Point<T> minPoint(size_t i) const{
+        return Point<T>(minX[i], minY[i], minZ[i]);
+    }
+
+    // Пересечение с замкнутым боксом, касание гранями считается пересечением
+    bool intersects(size_t i, const BoundingBox<T>& other) const{
+        return minX[i] <= other.max.x && maxX[i] >= other.min.x &&
+               minY[i] <= other.max.y && maxY[i] >= other.min.y &&
+               minZ[i] <= other.max.z && maxZ[i] >= other.min.z;
+    }
+
+    bool contains(size_t i, const Point<T>& p) const{
+        return p.x >= minX[i] && p.x <= maxX[i] && p.y >= minY[i] && p.y <= maxY[i] && p.z >= minZ[i] && p.z <= maxZ[i];
+    }
+
+    void erase(size_t i){
+        size_t last = items.size() - 1;
+        if(i != last){
+            minX[i] = minX[last];
+            minY[i] = minY[last];
+            minZ[i] = minZ[last];
+            maxX[i] = maxX[last];
+            maxY[i] = maxY[last];
+            maxZ[i] = maxZ[last];
+            items[i] = std::move(items[last]);
+        }
+        minX.pop_back();
+        minY.pop_back();
+        minZ.pop_back();
+        maxX.pop_back();
+        maxY.pop_back();
+        maxZ.pop_back();
+        items.pop_back();
+    }
+
+    void append(const EntryList& other){
+        minX.insert(minX.end(), other.minX.begin(), other.minX.end());
+        minY.insert(minY.end(), other.minY.begin(), other.minY.end());
+        minZ.insert(minZ.end(), other.minZ.begin(), other.minZ.end());
+        maxX.insert(maxX.end(), other.maxX.begin(), other.maxX.end());
+        maxY.insert(maxY.end(), other.maxY.begin(), other.maxY.end());
+        maxZ.insert(maxZ.end(), other.maxZ.begin(), other.maxZ.end());
+        items.insert(items.end(), other.items.begin(), other.items.end());
+    }
+
+    void clear(){
+        minX.clear();
+        minY.clear();
+        minZ.clear();
+        maxX.clear();
+        maxY.clear();
+        maxZ.clear();
+        items.clear();
+    }
+};
+
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef EPOCHDOMAIN_HPP
+#define EPOCHDOMAIN_HPP
+
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+
+// Отложенное освобождение по эпохам. Читатель на время чтения закрепляет
+// текущую эпоху в одном из слотов (Guard), писатель снимает объект с публикации
+// и отдаёт его в retire. Объект освобождается, когда все закреплённые эпохи
+// новее эпохи его снятия: значит, ни один читатель его больше не видит.
+// Слотов Slots; если все заняты, Guard не закрепляется (pinned() == false), и
+// читатель должен идти основным путём под блокировкой, а не ждать слот.
+class EpochDomain{
+    public:
+        static constexpr size_t Slots = 64;
+
+        class Guard{
+            private:
+                const EpochDomain& domain;
+                size_t slot;
+
+            public:
+                explicit Guard(const EpochDomain& domain) : domain(domain), slot(domain.pin()) {}
+                Guard(const Guard&) = delete;
+                Guard& operator=(const Guard&) = delete;
+
+                ~Guard(){
+                    if(pinned()){
+                        domain.active[slot].store(0);
+                    }
+                }
+
+                bool pinned() const{
+                    return slot != Slots;
+                }
+        };
+
+    private:
+        struct Retired{
+            uint64_t epoch;
+            std::function<void()> free;
+        };
+
+        std::atomic<uint64_t> epoch{1};
+        // 0 - слот свободен, иначе эпоха, закреплённая читателем
+        mutable std::array<std::atomic<uint64_t>, Slots> active{};
+        std::mutex retired_mtx;
+        std::vector<Retired> retired;
+
+        // Слот ищется с места, зависящего от потока, чтобы читатели не толкались в одном.
+        // Один проход; Slots - свободного слота нет
+        size_t pin() const{
+            size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % Slots;
+            for(size_t i = 0; i < Slots; ++i){
+                size_t slot = (start + i) % Slots;
+                uint64_t expected = 0;
+                if(active[slot].load(std::memory_order_relaxed) == 0 && active[slot].compare_exchange_strong(expected, epoch.load())){
+                    return slot;
+                }
+            }
+            return Slots;
+        }
+
+        uint64_t oldestActive() const{
+            uint64_t oldest = UINT64_MAX;
+            for(auto& slot : active){
+                uint64_t value = slot.load();
+                if(value != 0 && value < oldest){
+                    oldest = value;
+                }
+            }
+            return oldest;
+        }
+
+    public:
+        EpochDomain() = default;
+        EpochDomain(const EpochDomain&) = delete;
+        EpochDomain& operator=(const EpochDomain&) = delete;
+
+        ~EpochDomain(){
+            for(auto& item : retired){
+                item.free();
+            }
+        }
+
+        // Объект уже снят с публикации; освободится, когда его не сможет видеть ни один читатель.
+        // Возвращает, сколько объектов ждут освобождения
+        template <typename T>
+        size_t retire(const T* object){
+            std::lock_guard<std::mutex> lock(retired_mtx);
+            retired.push_back(Retired{epoch.fetch_add(1), [object](){ delete object; }});
+            return retired.size();
+        }
+
+        // Освобождает всё, что старше самой старой закреплённой эпохи
+        size_t collect(){
+            std::lock_guard<std::mutex> lock(retired_mtx);
+            uint64_t oldest = oldestActive();
+            auto keep = std::partition(retired.begin(), retired.end(), [oldest](const Retired& item){ return item.epoch >= oldest; });
+            for(auto it = keep; it != retired.end(); ++it){
+                it->free();
+            }
+            size_t freed = retired.end() - keep;
+            retired.erase(keep, retired.end());
+            return freed;
+        }
+
+        size_t pending(){
+            std::lock_guard<std::mutex> lock(retired_mtx);
+            return retired.size();
+        }
+};
+
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef NODEARENA_HPP
+#define NODEARENA_HPP
+
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+
+// Пул узлов октодерева. Дети одного узла всегда создаются и удаляются вместе,
+// поэтому память выдаётся блоками по 8 узлов, а освобождённые блоки
+// складываются в free-list и переиспользуются при следующем split.
+template <typename Node>
+class NodeArena{
+    public:
+        static constexpr size_t BlockSize = 8;
+
+    private:
+        std::vector<std::unique_ptr<Node[]>> blocks;
+        std::vector<Node*> freeBlocks;
+
+    public:
+        NodeArena() = default;
+        NodeArena(const NodeArena&) = delete;
+        NodeArena& operator=(const NodeArena&) = delete;
+        NodeArena(NodeArena&&) noexcept = default;
+        NodeArena& operator=(NodeArena&&) noexcept = default;
+
+        Node* acquire(){
+            if(!freeBlocks.empty()){
+                Node* block = freeBlocks.back();
+                freeBlocks.pop_back();
+                return block;
+            }
+            blocks.push_back(std::make_unique<Node[]>(BlockSize));
+            return blocks.back().get();
+        }
+
+        void release(Node* block){
+            if(block == nullptr){
+                return;
+            }
+            for(size_t i = 0; i < BlockSize; ++i){
+                block[i].reset();
+            }
+            freeBlocks.push_back(block);
+        }
+
+        size_t allocatedBlocks() const{
+            return blocks.size();
+        }
+
+        size_t freeBlockCount() const{
+            return freeBlocks.size();
+        }
+};
+
+
+#endif
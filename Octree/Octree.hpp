@@ -6,32 +6,30 @@
 #include <iostream>
 #include <algorithm>
 #include "ContainerPosition.hpp"
+#include "BoundingBox.hpp"
+#include "EntryList.hpp"
+#include "NodeArena.hpp"
+#include "OctreeLayout.hpp"
+#include "SplitPolicy.hpp"
+#include "../Container/I/ContainerId.hpp"
+#include "../ThreadPool/ThreadPool.hpp"
 #include <tuple>
 #include <stack>
 #include <memory>
 #include <type_traits>
-#include <regex>
-
-
-template<typename T>
-concept NumericConcept = std::is_arithmetic_v<T> || std::convertible_to<T, double>;
+#include <functional>
+#include <array>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <string>
+#include <ranges>
 
 
 template <typename T>
 concept SmartPointerConcept = std::is_base_of<std::shared_ptr<typename T::element_type>, T>::value || std::is_base_of<std::unique_ptr<typename T::element_type>, T>::value;
 
 
-template<typename T>
-concept PointConcept = requires(T a) {
-    { a.x } -> NumericConcept;
-    { a.y } -> NumericConcept;
-    { a.z } -> NumericConcept;
-    
-    { a == std::declval<T>() } -> std::same_as<bool>;
-    { a < std::declval<T>() } -> std::same_as<bool>;
-};
-
-
 template<typename T>
 concept ContainerPositionConcept = requires(T c) {
     { c.LLDown } -> PointConcept;
@@ -52,237 +50,469 @@ template <typename N>
 concept ContainerConcept = SmartPointerConcept<N>;
 
 
-template<typename T>
-concept BoundingBoxConcept = PointConcept<Point<T>>;
-
-template <typename T>
-requires BoundingBoxConcept<T>
-struct BoundingBox{
-    Point<T> min, max;
-    BoundingBox(const Point<T>& m, const Point<T>& ma) : min(m), max(ma) {}
-
-    bool contains(Point<T>& p) const {
-        return min.x < p.x && p.x < max.x && min.y < p.y && p.y < max.y && min.z < p.z && p.z < max.z;
-    }
-
-    bool intersects(BoundingBox& other) const {
-        return (max.x >= other.min.x && min.x <= other.max.x) &&
-                (max.y >= other.min.y && min.y <= other.max.y) &&
-                (max.z >= other.min.z && min.z <= other.max.z);
-    }
-};
-
-
-
-template <typename T, typename N, typename CPosType>
-requires ContainerConcept<N> && ContainerPositionConcept<CPosType> && BoundingBoxConcept<T>
+template <typename T, typename N, typename CPosType, typename Layout = TightLayout>
+requires ContainerConcept<N> && ContainerPositionConcept<CPosType> && BoundingBoxConcept<T> && OctreeLayoutConcept<Layout, T>
 class Octree{
     public:
         struct Node{
-            std::vector<std::pair<CPosType, N>> con;
-            std::array<std::shared_ptr<Node>, 8> children;
-            BoundingBox<T> box;
-            std::weak_ptr<Node> parent;
+            EntryList<T, N> con;
+            Node* children = nullptr;
+            BoundingBox<T> box;   // габарит, в который должны помещаться контейнеры узла
+            BoundingBox<T> cell;  // ячейка узла, делится пополам при split
+            Node* parent = nullptr;
             int height;
-            Node(BoundingBox<T> box, int height) : box(box), height(height) {}
+            Node() : box(Point<T>(), Point<T>()), cell(Point<T>(), Point<T>()), height(0) {}
+            Node(BoundingBox<T> box, int height) : box(box), cell(box), height(height) {}
 
             bool isLeaf() const {
-               return std::all_of(children.begin(), children.end(), [](const std::shared_ptr<Node>& child) { return child == nullptr; });
+               return children == nullptr;
+            }
+
+            Node* child(int i) const {
+                return children == nullptr ? nullptr : children + i;
+            }
+
+            std::vector<std::pair<CPosType, N>> getCon() const{
+                std::vector<std::pair<CPosType, N>> result;
+                result.reserve(con.size());
+                for(size_t i = 0; i < con.size(); ++i){
+                    result.push_back(std::make_pair(toPosition(con.box(i)), con.items[i]));
+                }
+                return result;
             }
 
-            std::vector<std::pair<CPosType, N>> getCon(){
-                return con;
+            void reset(){
+                con.clear();
+                children = nullptr;
+                parent = nullptr;
+                height = 0;
             }
 
         };
 
 
+        // Обход узлов в прямом порядке без стека: следующий узел находится
+        // по указателю на родителя, потому что дети лежат одним блоком
         class iterator {
             private:
-                std::stack<std::shared_ptr<Node>> nodeStack;
+                Node* current = nullptr;
 
             public:
-                using value_type = std::shared_ptr<Node>;
+                using value_type = Node*;
                 using pointer = value_type*;
                 using reference = value_type&;
                 using difference_type = std::ptrdiff_t;
                 using iterator_category = std::forward_iterator_tag;
 
             public:
+                iterator() = default;
 
-                explicit iterator(std::shared_ptr<Node>  root) {
-                    if (root != nullptr) {
-                        nodeStack.push(root);
-                    }
-                }
+                explicit iterator(Node* root) : current(root) {}
 
                 reference operator*() {
-                    return nodeStack.top();
+                    return current;
                 }
 
 
                 iterator& operator++() {
-                    if (nodeStack.empty()) return *this;
-                    std::shared_ptr<Node> current = nodeStack.top();
-                    nodeStack.pop();
-                    for (int i = 7; i >= 0; --i) {
-                        if (current->children[i]) {
-                            nodeStack.push(current->children[i]);
-                        }
+                    if (current != nullptr) {
+                        current = nextNode(current);
                     }
                     return *this;
                 }
 
                 
+                bool operator==(const iterator& other) const {
+                    return current == other.current;
+                }
+
                 bool operator!=(const iterator& other) const {
-                    return nodeStack != other.nodeStack;
+                    return current != other.current;
                 }
         };
 
+
+        // Контейнер вместе с его габаритом. Ссылка на item действительна, пока дерево не меняется.
+        struct EntryRef{
+            BoundingBox<T> box;
+            const N& item;
+
+            CPosType position() const{
+                return toPosition(box);
+            }
+        };
+
+
+        // Итератор по контейнерам всего дерева, без выделения памяти.
+        // operator* возвращает EntryRef по значению (proxy-ссылка).
+        class const_entry_iterator {
+            private:
+                Node* node = nullptr;
+                size_t slot = 0;
+
+                void skipEmpty() {
+                    while (node != nullptr && slot >= node->con.size()) {
+                        node = nextNode(node);
+                        slot = 0;
+                    }
+                }
+
+            public:
+                using value_type = EntryRef;
+                using reference = EntryRef;
+                using difference_type = std::ptrdiff_t;
+                using iterator_concept = std::forward_iterator_tag;
+                using iterator_category = std::input_iterator_tag;
+
+                const_entry_iterator() = default;
+
+                explicit const_entry_iterator(Node* root) : node(root) {
+                    skipEmpty();
+                }
+
+                EntryRef operator*() const {
+                    return EntryRef{node->con.box(slot), node->con.items[slot]};
+                }
+
+                const_entry_iterator& operator++() {
+                    ++slot;
+                    skipEmpty();
+                    return *this;
+                }
+
+                const_entry_iterator operator++(int) {
+                    const_entry_iterator copy = *this;
+                    ++*this;
+                    return copy;
+                }
+
+                bool operator==(const const_entry_iterator& other) const = default;
+        };
+
+
+        class EntryRange : public std::ranges::view_interface<EntryRange> {
+            private:
+                Node* root = nullptr;
+
+            public:
+                EntryRange() = default;
+
+                explicit EntryRange(Node* root) : root(root) {}
+
+                const_entry_iterator begin() const {
+                    return const_entry_iterator(root);
+                }
+
+                const_entry_iterator end() const {
+                    return const_entry_iterator();
+                }
+        };
+
+        static constexpr size_t ParallelBuildThreshold = 4096;
+
     private:
-        std::shared_ptr<Node> root;
-        int depth_;
+        struct Location{
+            Node* node;
+            size_t slot;
+        };
+
+        NodeArena<Node> arena;
+        std::unordered_map<ContainerId, Location> index;
+        std::unique_ptr<Node> rootNode;
+        Node* root = nullptr;
+        SplitPolicy<T> policy_;
     public:
 
         Octree(){}
-        Octree(BoundingBox<T> bbox, int depth) {
-        depth_ = depth;
-        root = std::make_shared<Node>(bbox, 0);
-    }
+        Octree(BoundingBox<T> bbox, int depth) : Octree(bbox, depthPolicy(depth)) {}
+
+        Octree(BoundingBox<T> bbox, SplitPolicy<T> policy) {
+            policy.validate();
+            policy_ = policy;
+            rootNode = std::make_unique<Node>(bbox, 0);
+            root = rootNode.get();
+        }
+
+        // Пакетная сборка: дерево строится одним проходом сверху вниз по уже
+        // проверенным контейнерам, без SearchInsert и постепенных split.
+        // Если передан пул, большие октанты собираются параллельно.
+        Octree(BoundingBox<T> bbox, SplitPolicy<T> policy, std::vector<std::pair<BoundingBox<T>, N>> entries, ThreadPool* pool = nullptr) : Octree(bbox, policy) {
+            for(auto& entry : entries){
+                if(!root->box.contains(entry.first)){
+                    throw std::invalid_argument("Container is outside of the octree bounds");
+                }
+            }
+            std::mutex arenaMtx;
+            build(root, std::move(entries), arenaMtx, pool);
+            reindex(root);
+        }
+
+        Octree(BoundingBox<T> bbox, int depth, std::vector<std::pair<BoundingBox<T>, N>> entries, ThreadPool* pool = nullptr) : Octree(bbox, depthPolicy(depth), std::move(entries), pool) {}
+
+        Octree(const Octree&) = delete;
+        Octree& operator=(const Octree&) = delete;
+        // root смотрит в rootNode, поэтому у перемещённого дерева его надо обнулить
+        Octree(Octree&& other) noexcept
+            : arena(std::move(other.arena)), index(std::move(other.index)), rootNode(std::move(other.rootNode)), root(rootNode.get()), policy_(other.policy_) {
+            other.root = nullptr;
+        }
+
+        Octree& operator=(Octree&& other) noexcept{
+            if(this != &other){
+                arena = std::move(other.arena);
+                index = std::move(other.index);
+                rootNode = std::move(other.rootNode);
+                root = rootNode.get();
+                policy_ = other.policy_;
+                other.root = nullptr;
+            }
+            return *this;
+        }
 
 
-        std::shared_ptr<Node>  getRoot(){
+        Node* getRoot(){
             return root;
         }
 
 
+        size_t allocatedBlocks() const{
+            return arena.allocatedBlocks();
+        }
+
+
+        size_t freeBlocks() const{
+            return arena.freeBlockCount();
+        }
+
+
         iterator begin() const{
             return iterator(root);
         }
 
+        EntryRange entries() const{
+            return EntryRange(root);
+        }
+
+
+        // Обходит все контейнеры дерева без выделения памяти. Если visitor
+        // возвращает bool, то false останавливает обход.
+        template <typename Visitor>
+        void forEachEntry(Visitor&& visitor) const{
+            for(Node* node = root; node != nullptr; node = nextNode(node)){
+                const EntryList<T, N>& con = node->con;
+                for(size_t i = 0; i < con.size(); ++i){
+                    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const BoundingBox<T>&, const N&>, bool>){
+                        if(!visitor(con.box(i), con.items[i])){
+                            return;
+                        }
+                    }else{
+                        visitor(con.box(i), con.items[i]);
+                    }
+                }
+            }
+        }
+
+
         iterator end() const{
             return iterator(nullptr);
         }
 
 
-        bool insert(N container, CPosType& position, std::shared_ptr<Node> target){
+        bool insert(N container, const CPosType& position, Node* target){
+            return insert(container, toBox(position), target);
+        }
+
+
+        bool insert(N container, const BoundingBox<T>& box, Node* target){
             if(target == nullptr){
                 return false;
             }
-            target->con.push_back(std::make_pair(position, container));
-            if (target->con.empty() == false && target->con.size() > 4 && target->isLeaf() && target->height < depth_){
-                std::cout << "Split\n";
+            target->con.push_back(box, container);
+            indexEntry(target, target->con.size() - 1);
+            if (canSplit(target)){
                 split(target);
             }
             return true;
         }
 
 
-       void split(std::shared_ptr<Node> node) {
+       void split(Node* node) {
     if (!node) return;  // Проверка на nullptr
-    if (node->children[0] != nullptr) return;  // Если дочерние узлы уже созданы, ничего не делаем
-
-    Point<T> min = node->box.min;
-    Point<T> max = node->box.max;
-
-    T midX = (min.x + max.x) / 2;
-    T midY = (min.y + max.y) / 2;
-    T midZ = (min.z + max.z) / 2;
-
-    // Создание детей с их соответствующими границами
-    node->children[0] = std::make_shared<Node>(BoundingBox<T>(min, Point<T>(midX, midY, midZ)), node->height + 1); // 0: мин
-    node->children[1] = std::make_shared<Node>(BoundingBox<T>(Point<T>(midX, min.y, min.z), Point<T>(max.x, midY, midZ)), node->height + 1); // 1: x+
-    node->children[2] = std::make_shared<Node>(BoundingBox<T>(Point<T>(min.x, midY, min.z), Point<T>(midX, max.y, midZ)), node->height + 1); // 2: y+
-    node->children[3] = std::make_shared<Node>(BoundingBox<T>(Point<T>(midX, midY, min.z), Point<T>(max.x, max.y, midZ)), node->height + 1); // 3: xy+
-    node->children[4] = std::make_shared<Node>(BoundingBox<T>(Point<T>(min.x, min.y, midZ), Point<T>(midX, midY, max.z)), node->height + 1); // 4: z+
-    node->children[5] = std::make_shared<Node>(BoundingBox<T>(Point<T>(midX, min.y, midZ), Point<T>(max.x, midY, max.z)), node->height + 1); // 5: x+z+
-    node->children[6] = std::make_shared<Node>(BoundingBox<T>(Point<T>(min.x, midY, midZ), Point<T>(midX, max.y, max.z)), node->height + 1); // 6: y+z+
-    node->children[7] = std::make_shared<Node>(BoundingBox<T>(Point<T>(midX, midY, midZ), max), node->height + 1); // 7: xyz+
-    node->children[0]->parent = node;
-    node->children[1]->parent = node;
-    node->children[2]->parent = node;
-    node->children[3]->parent = node;
-    node->children[4]->parent = node;
-    node->children[5]->parent = node;
-    node->children[6]->parent = node;
-    node->children[7]->parent = node;
+    if (!node->isLeaf()) return;  // Если дочерние узлы уже созданы, ничего не делаем
+
+    makeChildren(node);
     // Перемещение объектов из текущего узла в дочерние
-    for (auto it = node->con.begin(); it != node->con.end(); ) {
-        bool moved = false;  // Флаг для отслеживания перемещения
-
-        for (int i = 0; i < 8; ++i) {
-            if (node->children[i]->box.contains(it->first.LLDown) && 
-                node->children[i]->box.contains(it->first.LLUp) &&
-                node->children[i]->box.contains(it->first.LRDown) &&
-                node->children[i]->box.contains(it->first.LRUp) &&
-                node->children[i]->box.contains(it->first.RLDown) &&
-                node->children[i]->box.contains(it->first.RLUp) &&
-                node->children[i]->box.contains(it->first.RRDown) &&
-                node->children[i]->box.contains(it->first.RRUp)) {
-                node->children[i]->con.push_back(*it);
-                moved = true; // Успех перемещения
-                break; // Если успешно переместили, выходим из цикла
-            }
-        }
-
-        if (moved) {
-            it = node->con.erase(it); // Удаляем элемент и перемещаем итератор
+    for (size_t k = 0; k < node->con.size(); ) {
+        BoundingBox<T> box = node->con.box(k);
+        Node* child = childFor(node, box);
+
+        if (child != nullptr) {
+            child->con.push_back(box, node->con.items[k]);
+            indexEntry(child, child->con.size() - 1);
+            node->con.erase(k); // На место k встаёт последний элемент
+            if (k < node->con.size()) {
+                indexEntry(node, k);
+            }
         } else {
-            ++it; // Если не переместили, просто увеличиваем итератор
+            ++k; // Если не переместили, просто увеличиваем индекс
         }
     }
 }
 
         Octree Clone() const{
-            auto clone = Octree(this->root->box, this->depth_);
+            auto clone = Octree(this->root->box, this->policy_);
             return clone;
         }
 
 
 
         bool remove(std::string id){
-            bool collision = false;
-            std::shared_ptr<Node> copy = nullptr;
-            Point<T> point = parsePoint(id);
-            removeR(id, root, collision, copy, point);
-            if(collision == false){
+            return remove(ContainerId::parse(id));
+        }
+
+
+        bool remove(ContainerId id){
+            auto it = index.find(id);
+            if(it == index.end()){
                 return false;
             }
-            collision = false;
-            Update(copy);
+            Node* node = it->second.node;
+            eraseEntry(node, it->second.slot);
+            Update(node);
             return true;
         }
 
 
-        std::shared_ptr<Node> search(std::string id) const{
-            Point<T> point = parsePoint(id);
-            std::shared_ptr<Node> copyCache = nullptr;
-            searchR(id, root, copyCache, point);
-            return copyCache;
+        // Достаёт контейнер из узла без перестройки дерева, узел остаётся
+        // валидным для обратной вставки через insert()
+        Node* extract(std::string id, std::pair<CPosType, N>& item){
+            return extract(ContainerId::parse(id), item);
+        }
+
+
+        Node* extract(ContainerId id, std::pair<CPosType, N>& item){
+            auto it = index.find(id);
+            if(it == index.end()){
+                return nullptr;
+            }
+            Node* node = it->second.node;
+            size_t slot = it->second.slot;
+            item = std::make_pair(toPosition(node->con.box(slot)), node->con.items[slot]);
+            eraseEntry(node, slot);
+            return node;
+        }
+
+
+        Node* search(std::string id) const{
+            return search(ContainerId::parse(id));
+        }
+
+
+        Node* search(ContainerId id) const{
+            auto it = index.find(id);
+            return it == index.end() ? nullptr : it->second.node;
         }
 
 
         std::pair<CPosType, N> findI(std::string id) const{
-            Point<T> point = parsePoint(id);
-            std::pair<CPosType, N> it = std::make_pair(CPosType(), nullptr);
-            findI(id, root, &it, point);
-            return it;
+            return findI(ContainerId::parse(id));
+        }
+
+
+        std::pair<CPosType, N> findI(ContainerId id) const{
+            auto it = index.find(id);
+            if(it == index.end()){
+                return std::make_pair(CPosType(), nullptr);
+            }
+            const Node* node = it->second.node;
+            size_t slot = it->second.slot;
+            return std::make_pair(toPosition(node->con.box(slot)), node->con.items[slot]);
+        }
+
+
+        static ContainerId keyOf(const Point<T>& p){
+            return ContainerId(static_cast<int>(p.x), static_cast<int>(p.y), static_cast<int>(p.z));
+        }
+
+
+        // Сколько контейнеров лежит на каждой глубине, [0] - корень
+        std::vector<size_t> entriesPerDepth() const{
+            std::vector<size_t> result(policy_.maxDepth + 1, 0);
+            for(auto it = begin(); it != end(); ++it){
+                result[(*it)->height] += (*it)->con.size();
+            }
+            return result;
+        }
+
+
+        const SplitPolicy<T>& splitPolicy() const{
+            return policy_;
+        }
+
+
+        size_t size() const{
+            return index.size();
         }
 
 
         std::vector<std::pair<CPosType, N>> searchDepth() const{
-            std::vector<std::pair<CPosType, N>> copyCache(0);
-            searchDepth(root, copyCache);
+            std::vector<std::pair<CPosType, N>> copyCache;
+            copyCache.reserve(size());
+            forEachEntry([&copyCache](const BoundingBox<T>& box, const N& item){
+                copyCache.push_back(std::make_pair(toPosition(box), item));
+            });
             return copyCache;
         }
 
 
-        std::shared_ptr<Node> SearchInsert(N container, CPosType pos) const{
+        // Обходит только узлы, пересекающие box, и отдаёт visitor'у каждый
+        // контейнер, чей габарит пересекает box (касание гранями считается).
+        // Если visitor возвращает bool, false прекращает обход.
+        template <typename Visitor>
+        void queryBox(const BoundingBox<T>& box, Visitor&& visitor) const{
+            queryBox(root, box, visitor);
+        }
+
+
+        std::vector<std::pair<CPosType, N>> queryBox(const BoundingBox<T>& box) const{
+            std::vector<std::pair<CPosType, N>> result;
+            queryBox(box, [&result](const BoundingBox<T>& entry, const N& item){
+                result.push_back(std::make_pair(toPosition(entry), item));
+            });
+            return result;
+        }
+
+
+        Node* SearchInsert(N container, CPosType pos) const{
+            return SearchInsert(container, toBox(pos));
+        }
+
+
+        // Самый глубокий узел, строго содержащий box, или nullptr, если box
+        // выходит за границы склада или задевает уже стоящий контейнер.
+        // Проверка пересечений идёт по дереву на месте, без копирования содержимого узлов.
+        Node* SearchInsert(N, const BoundingBox<T>& box) const{
+            if(root == nullptr || !root->box.contains(box)){
+                return nullptr;
+            }
+            Node* target = root;
+            while(Node* next = childFor(target, box)){
+                target = next;
+            }
+            if(collides(box)){
+                return nullptr;
+            }
+            return target;
+        }
+
+
+        bool collides(const BoundingBox<T>& box) const{
             bool collision = false;
-            std::shared_ptr<Node> copyCache = nullptr;
-            std::vector<std::pair<CPosType, N>> copy(0);
-            SearchInsert(container, pos, root, copyCache, copy, collision);
-            return copyCache;
+            queryBox(box, [&collision](const BoundingBox<T>&, const N&){
+                collision = true;
+                return false;
+            });
+            return collision;
         }
 
 
@@ -363,289 +593,269 @@ class Octree{
         }
 
 
+        static BoundingBox<T> toBox(const CPosType& position){
+            return BoundingBox<T>(Point<T>(getMinX(position), getMinY(position), getMinZ(position)),
+                                  Point<T>(getMaxX(position), getMaxY(position), getMaxZ(position)));
+        }
+
+
+        // Восемь углов восстанавливаются из габарита только по запросу (отрисовка, старый API)
+        static CPosType toPosition(const BoundingBox<T>& box){
+            const Point<T>& lo = box.min;
+            const Point<T>& hi = box.max;
+            return CPosType(Point<T>(lo.x, lo.y, lo.z), Point<T>(lo.x, lo.y, hi.z),
+                            Point<T>(hi.x, lo.y, lo.z), Point<T>(hi.x, lo.y, hi.z),
+                            Point<T>(hi.x, hi.y, lo.z), Point<T>(hi.x, hi.y, hi.z),
+                            Point<T>(lo.x, hi.y, lo.z), Point<T>(lo.x, hi.y, hi.z));
+        }
+
+
         bool push(N container, CPosType& position){
-            std::shared_ptr<Node> target = SearchInsert(container, position);
+            Node* target = SearchInsert(container, position);
             return insert(container, position, target);
         }
 
-        static bool pointincontainer(Point<T>& p, CPosType& position){
+        static bool pointincontainer(const Point<T>& p, const CPosType& position){
             static_assert(PointConcept<Point<T>>, "T должен удовлетворять PointConcept");
             static_assert(ContainerPositionConcept<CPosType>, "CPosType должен удовлетворять ContainerPositionConcept");
-            T minX = getMinX(position);
-            T maxX = getMaxX(position);
-            T minY = getMinY(position);
-            T maxY = getMaxY(position);
-            T minZ = getMinZ(position);
-            T maxZ = getMaxZ(position);
-            return (p.x >= minX && p.x <= maxX && p.y >= minY && p.y <= maxY && p.z >= minZ && p.z <= maxZ);
+            return pointincontainer(p, toBox(position));
         }
 
 
-        private:
+        static bool pointincontainer(const Point<T>& p, const BoundingBox<T>& box){
+            return (p.x >= box.min.x && p.x <= box.max.x && p.y >= box.min.y && p.y <= box.max.y && p.z >= box.min.z && p.z <= box.max.z);
+        }
 
 
-        void  searchUnderOct(std::shared_ptr<Node> node, std::vector<std::pair<CPosType, N>>& vec) const{
-            if(node == nullptr){
-                return;
-            }
-            if(!node->con.empty()){
-                vec.insert(vec.end(), node->con.begin(), node->con.end());
-            }
-            for(int i = 0; i < 8; ++i){
-                searchUnderOct(node->children[i], vec);
-            }
-        }
+        private:
 
 
-        void findI(std::string id, std::shared_ptr<Node> node, std::pair<CPosType, N>* it, Point<T> point) const{
-            if(node == nullptr){
-                return;
-            }
-            if(!node->box.contains(point)){
-                return;
+        template <typename Visitor>
+        bool queryBox(const Node* node, const BoundingBox<T>& box, Visitor& visitor) const{
+            if(node == nullptr || !node->box.intersects(box)){
+                return true;
             }
-            if(node->con.empty() == false){
-                for(auto& i : node->con){
-                    if(i.first.LLDown.x != -1 && i.second != nullptr && number(i.first.LLDown) == id){
-                        *it = i;
-                        return;
+            const EntryList<T, N>& con = node->con;
+            for(size_t i = 0; i < con.size(); ++i){
+                if(!con.intersects(i, box)){
+                    continue;
+                }
+                if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const BoundingBox<T>&, const N&>, bool>){
+                    if(!visitor(con.box(i), con.items[i])){
+                        return false;
                     }
+                }else{
+                    visitor(con.box(i), con.items[i]);
                 }
             }
-            if(node->isLeaf() == false){
-                for(int i = 0; i < 8; ++i){
-                    findI(id, node->children[i], it, point);
+            for(int i = 0; i < 8; ++i){
+                if(!queryBox(node->child(i), box, visitor)){
+                    return false;
                 }
             }
+            return true;
         }
 
 
-        void searchDepth(std::shared_ptr<Node> node, std::vector<std::pair<CPosType, N>>& copyCache) const{
-            if(node == nullptr){
-                return;
+        static Node* nextNode(Node* node) {
+            if (!node->isLeaf()) {
+                return node->children;
             }
-            if(!node->con.empty()){//
-                (copyCache).insert((copyCache).end(), node->con.begin(), node->con.end());
-            }
-            for(int i = 0; i < 8; ++i){
-                searchDepth(node->children[i], copyCache);
+            while (node->parent != nullptr) {
+                if (node != node->parent->children + 7) {
+                    return node + 1;
+                }
+                node = node->parent;
             }
+            return nullptr;
         }
 
 
-        bool SearchInsert(N container, CPosType pos, std::shared_ptr<Node> node, std::shared_ptr<Node>& copyCache, std::vector<std::pair<CPosType, N>>& copy, bool& collision) const{
-            if(node == nullptr){
-                return false;
-            }
-             if (!node->box.contains(pos.LLDown) || !node->box.contains(pos.LLUp) ||
-                !node->box.contains(pos.LRDown) || !node->box.contains(pos.LRUp) ||
-                !node->box.contains(pos.RLDown) || !node->box.contains(pos.RLUp) ||
-                !node->box.contains(pos.RRDown) || !node->box.contains(pos.RRUp)) {
-                return false;
-            }
-            if(!node->con.empty()){
-                (copy).insert((copy).end(), node->con.begin(), node->con.end());
-            }
-            if (node->isLeaf() == false && collision == false && copyCache == nullptr) {
-                for (size_t i = 0; i < 8; ++i) {
-                     SearchInsert(container, pos, node->children[i], copyCache, copy, collision);
+            // Дочерний узел, в который спускается box: октант выбирается по центру box
+            // относительно середины ячейки, а сам box должен поместиться в бокс ребёнка.
+            // nullptr, если узел - лист или box пересекает границу бокса ребёнка.
+            static Node* childFor(const Node* node, const BoundingBox<T>& box) {
+                if (node->isLeaf()) {
+                    return nullptr;
                 }
-            }
-            if(collision == false && copyCache == nullptr){
-                
-                searchUnderOct(node, copy);
-                
-                if(!checkCollision(container, pos, copy)){
-                    copyCache = node;
-                    return true;
-                }else{
-                    collision = true;
-                    return false;
+                const Point<T>& mid = node->children[7].cell.min;
+                int i = (box.min.x + box.max.x >= 2 * mid.x ? 1 : 0) |
+                        (box.min.y + box.max.y >= 2 * mid.y ? 2 : 0) |
+                        (box.min.z + box.max.z >= 2 * mid.z ? 4 : 0);
+                Node* child = node->children + i;
+                return child->box.contains(box) ? child : nullptr;
+            }
+
+
+            // Все 8 детей берутся из пула одним блоком
+            void makeChildren(Node* node) {
+                Point<T> min = node->cell.min;
+                Point<T> max = node->cell.max;
+
+                T midX = (min.x + max.x) / 2;
+                T midY = (min.y + max.y) / 2;
+                T midZ = (min.z + max.z) / 2;
+
+                Node* block = arena.acquire();
+                block[0].cell = BoundingBox<T>(min, Point<T>(midX, midY, midZ)); // 0: мин
+                block[1].cell = BoundingBox<T>(Point<T>(midX, min.y, min.z), Point<T>(max.x, midY, midZ)); // 1: x+
+                block[2].cell = BoundingBox<T>(Point<T>(min.x, midY, min.z), Point<T>(midX, max.y, midZ)); // 2: y+
+                block[3].cell = BoundingBox<T>(Point<T>(midX, midY, min.z), Point<T>(max.x, max.y, midZ)); // 3: xy+
+                block[4].cell = BoundingBox<T>(Point<T>(min.x, min.y, midZ), Point<T>(midX, midY, max.z)); // 4: z+
+                block[5].cell = BoundingBox<T>(Point<T>(midX, min.y, midZ), Point<T>(max.x, midY, max.z)); // 5: x+z+
+                block[6].cell = BoundingBox<T>(Point<T>(min.x, midY, midZ), Point<T>(midX, max.y, max.z)); // 6: y+z+
+                block[7].cell = BoundingBox<T>(Point<T>(midX, midY, midZ), max); // 7: xyz+
+                for (int i = 0; i < 8; ++i) {
+                    block[i].box = Layout::looseBox(block[i].cell);
+                    block[i].height = node->height + 1;
+                    block[i].parent = node;
                 }
-            }else if(collision == false && copyCache != nullptr){
-                return true;
+                node->children = block;
             }
-            return false;
-        }
 
 
-            void searchR(std::string id, std::shared_ptr<Node> node, std::shared_ptr<Node>& copyCache, Point<T> point)const{
-                if(node == nullptr){
+            void build(Node* node, std::vector<std::pair<BoundingBox<T>, N>> entries, std::mutex& arenaMtx, ThreadPool* pool) {
+                if (entries.size() <= policy_.leafCapacity || node->height >= policy_.maxDepth || !policy_.canSplit(node->cell)) {
+                    for (auto& entry : entries) {
+                        node->con.push_back(entry.first, std::move(entry.second));
+                    }
                     return;
                 }
-                if(!node->box.contains(point)){
-                    return;
+                {
+                    std::lock_guard<std::mutex> lock(arenaMtx);
+                    makeChildren(node);
                 }
-                if(node->con.empty() == false){
-                for(auto& i : node->con){
-                    if(i.first.LLDown.x != -1 && i.second != nullptr && number(i.first.LLDown) == id){
-                        copyCache = node;
-                        return;
+                std::array<std::vector<std::pair<BoundingBox<T>, N>>, 8> parts;
+                for (auto& entry : entries) {
+                    Node* child = childFor(node, entry.first);
+                    if (child != nullptr) {
+                        parts[child - node->children].push_back(std::move(entry));
+                    } else {
+                        node->con.push_back(entry.first, std::move(entry.second));
                     }
                 }
-            }
-            if(node->isLeaf() == false){
-                for(int i = 0; i < 8; ++i){
-                    searchR(id, node->children[i], copyCache, point);
+                if (pool != nullptr && entries.size() >= ParallelBuildThreshold) {
+                    std::vector<std::future<void>> tasks;
+                    ThreadPool::TaskGroup group(*pool);
+                    for (int i = 0; i < 8; ++i) {
+                        if (!parts[i].empty()) {
+                            tasks.push_back(group.submit([this, node, i, &parts, &arenaMtx, pool]() {
+                                build(&node->children[i], std::move(parts[i]), arenaMtx, pool);
+                            }));
+                        }
+                    }
+                    group.wait();
+                    for (auto& task : tasks) {
+                        task.get();
+                    }
+                } else {
+                    for (int i = 0; i < 8; ++i) {
+                        build(&node->children[i], std::move(parts[i]), arenaMtx, pool);
+                    }
                 }
             }
-        }
 
 
-            void removeR(std::string id, std::shared_ptr<Node> node, bool& collision, std::shared_ptr<Node>& copyCache, Point<T> point){
-                if(node == nullptr){
-                    return;
-                }
-                if(collision == true || node == nullptr){
+            void reindex(Node* node) {
+                if (node == nullptr) {
                     return;
                 }
-                if(!node->box.contains(point)){
-                    return;
+                for (size_t k = 0; k < node->con.size(); ++k) {
+                    indexEntry(node, k);
                 }
-                if(node->con.empty() == false){
-                    for(auto& i : node->con){
-                        if(i.first.LLDown.x != -1 && i.second != nullptr && number(i.first.LLDown) == id){
-                            if(i.second != nullptr){
-                                i.second.reset();
-                                //i.second = nullptr;
-                                node->con.erase(std::remove(node->con.begin(), node->con.end(), i), node->con.end());
-                            }
-                            collision = true;
-                            copyCache = node;
-                            return;
-                        }
-                    }
-                }
-                if(node->isLeaf() == false){
-                    for(int i = 0; i < 8; ++i){
-                        removeR(id, node->children[i], collision, copyCache, point);
-                    }
+                for (int i = 0; i < 8; ++i) {
+                    reindex(node->child(i));
                 }
+            }
 
+
+            static SplitPolicy<T> depthPolicy(int depth) {
+                SplitPolicy<T> policy;
+                policy.maxDepth = depth;
+                return policy;
             }
 
 
-            bool checkEmptyNode(std::shared_ptr<Node> node) const{
-            if (node == nullptr) return true; // Добавлена проверка на nullptr
-            for (int i = 0; i < 8; ++i) {
-                if (node->children[i] != nullptr && !node->children[i]->con.empty()) {
-                    return false;
-                }
+            bool canSplit(const Node* node) const {
+                return node->isLeaf() && node->con.size() > policy_.leafCapacity &&
+                       node->height < policy_.maxDepth && policy_.canSplit(node->cell);
             }
-            return true;
-        }
 
-           void mearge(std::shared_ptr<Node> node) {
-                if (node == nullptr || node->isLeaf()) return;
-                for (int i = 0; i < 8; ++i) {
-                    if (node->children[i] != nullptr && !node->children[i]->con.empty()) {
-                        node->con.insert(node->con.end(), node->children[i]->con.begin(), node->children[i]->con.end());
-                        node->children[i]->con.clear();
-                    }
+
+            // Число контейнеров в поддереве, подсчёт останавливается, как только превышен limit
+            size_t countEntries(const Node* node, size_t limit) const {
+                if (node == nullptr) {
+                    return 0;
                 }
-                for (int i = 0; i < 8; ++i) {
-                    mearge(node->children[i]);
+                size_t count = node->con.size();
+                for (int i = 0; i < 8 && count <= limit; ++i) {
+                    count += countEntries(node->child(i), limit - count);
                 }
+                return count;
             }
 
-            void decreaseHightTree(std::shared_ptr<Node> node) {
+
+            // Поднимает все контейнеры поддерева в node, блоки детей возвращаются в пул
+            void mearge(Node* node) {
                 if (node == nullptr || node->isLeaf()) {
                     return;
                 }
                 for (int i = 0; i < 8; ++i) {
-                    decreaseHightTree(node->children[i]);
-                }
-                if (checkEmptyNode(node)) {
-                    for (int i = 0; i < 8; ++i) {
-                        if (node->children[i] != nullptr && node->children[i]->isLeaf()) { 
-                            node->children[i].reset();
-                            node->children[i] = nullptr;
+                    Node* child = &node->children[i];
+                    mearge(child);
+                    if (!child->con.empty()) {
+                        size_t first = node->con.size();
+                        node->con.append(child->con);
+                        for (size_t k = first; k < node->con.size(); ++k) {
+                            indexEntry(node, k);
                         }
                     }
                 }
+                arena.release(node->children);
+                node->children = nullptr;
             }
 
 
-            void Update(std::shared_ptr<Node> node) {
-                 auto parentNode = node->parent.lock(); 
-                if(node == root && node->isLeaf() == false && node->con.empty()){
-                    mearge(node);
-                    decreaseHightTree(node);
-                    return;
-                }
-                if(checkEmptyNode(parentNode)){
-                    mearge(parentNode);
-                    decreaseHightTree(parentNode);
-                }
-            }
-
-
-            bool ContainEntity(CPosType pos1, CPosType pos2) const {
-                
-                int pos1MinX = getMinX(pos1);
-                int pos1MaxX = getMaxX(pos1);
-                int pos1MinY = getMinY(pos1);
-                int pos1MaxY = getMaxY(pos1);
-                int pos1MinZ = getMinZ(pos1);
-                int pos1MaxZ = getMaxZ(pos1);
-                
-
-                int pos2MinX = getMinX(pos2);
-                int pos2MaxX = getMaxX(pos2);
-                int pos2MinY = getMinY(pos2);
-                int pos2MaxY = getMaxY(pos2);
-                int pos2MinZ = getMinZ(pos2);
-                int pos2MaxZ = getMaxZ(pos2);
-
-
-                return (pos1MinX <= pos2MaxX && pos1MaxX >= pos2MinX) &&
-                    (pos1MinY <= pos2MaxY && pos1MaxY >= pos2MinY) &&
-                    (pos1MinZ <= pos2MaxZ && pos1MaxZ >= pos2MinZ);
-            }
-
-
-            bool checkCollision(N container, CPosType pos, std::vector<std::pair<CPosType, N>> copy) const {
-                for(auto it : copy){
-                    if(ContainEntity(it.first, pos)){
-                        return true;
+            // После удаления схлопывается самое высокое поддерево над node,
+            // в котором осталось не больше mergeCapacity контейнеров
+            void Update(Node* node) {
+                Node* target = nullptr;
+                for (Node* cur = node; cur != nullptr; cur = cur->parent) {
+                    if (countEntries(cur, policy_.mergeCapacity) > policy_.mergeCapacity) {
+                        break;
                     }
+                    target = cur;
                 }
-                return false; 
+                mearge(target);
             }
 
 
-            void printNode(std::shared_ptr<Node> node, int depth) const {
+            void printNode(Node* node, int depth) const {
                 if (!node) return;
 
                 std::cout << std::string(depth, '-') << "Node at depth " << depth 
                         << ": " << node->box.min.x << ", " << node->box.min.y << ", " << node->box.min.z 
                         << " to " << node->box.max.x << ", " << node->box.max.y << ", " << node->box.max.z << "\n";
-                for (auto& child : node->children) {
-                    printNode(child, depth + 1);
+                for (int i = 0; i < 8; ++i) {
+                    printNode(node->child(i), depth + 1);
                 }
             }
 
-            static std::string number(const Point<T>& p) {
-            return std::to_string(p.x) + "_" + std::to_string(p.y) + "_" + std::to_string(p.z);
-        }
+            // Запись в индексе: узел и позиция контейнера в его EntryList
+            void indexEntry(Node* node, size_t slot){
+                index[keyOf(node->con.minPoint(slot))] = Location{node, slot};
+            }
 
 
-        static Point<T> parsePoint(const std::string& str){
-            static_assert(PointConcept<Point<T>>, "Point должен удовлетворять PointConcept");
-            Point<T> point;
-            std::regex re(R"(([-+]?\d*\.?\d+)_([-+]?\d*\.?\d+)_([-+]?\d*\.?\d+))");
-            std::smatch match;
-            if (std::regex_match(str, match, re)) {
-                point.x = static_cast<T>(std::stod(match[1].str()));
-                point.y = static_cast<T>(std::stod(match[2].str()));
-                point.z = static_cast<T>(std::stod(match[3].str()));
-            } else {
-                throw std::invalid_argument("Invalid format for Point"); // 
+            void eraseEntry(Node* node, size_t slot){
+                index.erase(keyOf(node->con.minPoint(slot)));
+                node->con.erase(slot);
+                if(slot < node->con.size()){
+                    indexEntry(node, slot);
+                }
             }
 
-            return point;
-        }
-                
+
 };
 
 
@@ -0,0 +1,42 @@
+#ifndef OCTREELAYOUT_HPP
+#define OCTREELAYOUT_HPP
+
+
+#include "BoundingBox.hpp"
+
+
+template<typename L, typename T>
+concept OctreeLayoutConcept = requires(const BoundingBox<T>& cell) {
+    { L::looseBox(cell) } -> std::same_as<BoundingBox<T>>;
+};
+
+
+// Обычное октодерево: бокс дочернего узла совпадает с его ячейкой.
+// Контейнер, пересекающий среднюю плоскость, остаётся в родителе.
+struct TightLayout{
+    template <typename T>
+    static BoundingBox<T> looseBox(const BoundingBox<T>& cell){
+        return cell;
+    }
+};
+
+
+// Рыхлое октодерево: бокс дочернего узла растянут вокруг его ячейки в Num/Den раз,
+// поэтому контейнер, немного заходящий за среднюю плоскость, всё равно спускается вниз.
+// Ячейки детей по-прежнему делят родителя пополам, растягивается только бокс.
+template <int Num = 2, int Den = 1>
+struct LooseLayout{
+    static_assert(Den > 0 && Num >= Den, "Loose factor must be at least 1");
+
+    template <typename T>
+    static BoundingBox<T> looseBox(const BoundingBox<T>& cell){
+        T padX = (cell.max.x - cell.min.x) * (Num - Den) / (2 * Den);
+        T padY = (cell.max.y - cell.min.y) * (Num - Den) / (2 * Den);
+        T padZ = (cell.max.z - cell.min.z) * (Num - Den) / (2 * Den);
+        return BoundingBox<T>(Point<T>(cell.min.x - padX, cell.min.y - padY, cell.min.z - padZ),
+                              Point<T>(cell.max.x + padX, cell.max.y + padY, cell.max.z + padZ));
+    }
+};
+
+
+#endif
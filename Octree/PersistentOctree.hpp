@@ -0,0 +1,304 @@
+#ifndef PERSISTENTOCTREE_HPP
+#define PERSISTENTOCTREE_HPP
+
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include "BoundingBox.hpp"
+#include "SplitPolicy.hpp"
+#include "../Container/I/ContainerId.hpp"
+
+
+// Персистентное (path-copying) октодерево. Узлы неизменяемы и делятся между
+// версиями через shared_ptr: копия дерева - это копия указателя на корень, O(1),
+// а вставка и удаление копируют только путь от корня до затронутого узла.
+// Поэтому снимок и изменения в нём стоят памяти пропорционально изменениям.
+// Раскладка свободная: контейнер уходит в ребёнка, которому принадлежит его центр,
+// если не больше ребёнка по всем осям; границы детей при поиске расширяются.
+// Одну версию из нескольких потоков только читают; разные версии независимы.
+template <typename T, typename N>
+class PersistentOctree{
+    public:
+        struct Entry{
+            BoundingBox<T> box;
+            N item;
+        };
+
+    private:
+        struct Node{
+            BoundingBox<T> box;
+            std::vector<Entry> entries;
+            std::array<std::shared_ptr<const Node>, 8> children{};
+            size_t count = 0;   // контейнеров во всём поддереве
+
+            explicit Node(const BoundingBox<T>& box) : box(box) {}
+
+            bool leaf() const{
+                return children[0] == nullptr;
+            }
+        };
+
+        std::shared_ptr<const Node> root;
+        SplitPolicy<T> policy_;
+
+        static Point<T> middle(const BoundingBox<T>& box){
+            return Point<T>(box.min.x + (box.max.x - box.min.x) / 2, box.min.y + (box.max.y - box.min.y) / 2, box.min.z + (box.max.z - box.min.z) / 2);
+        }
+
+        static BoundingBox<T> childBox(const BoundingBox<T>& box, size_t i){
+            Point<T> mid = middle(box);
+            return BoundingBox<T>(Point<T>(i & 1 ? mid.x : box.min.x, i & 2 ? mid.y : box.min.y, i & 4 ? mid.z : box.min.z),
+                                  Point<T>(i & 1 ? box.max.x : mid.x, i & 2 ? box.max.y : mid.y, i & 4 ? box.max.z : mid.z));
+        }
+
+        // Граница, за которую не выходят контейнеры ребёнка: его бокс плюс полразмера с запасом
+        static BoundingBox<T> looseBox(const BoundingBox<T>& box){
+            T dx = (box.max.x - box.min.x) / 2 + 1;
+            T dy = (box.max.y - box.min.y) / 2 + 1;
+            T dz = (box.max.z - box.min.z) / 2 + 1;
+            return BoundingBox<T>(Point<T>(box.min.x - dx, box.min.y - dy, box.min.z - dz), Point<T>(box.max.x + dx, box.max.y + dy, box.max.z + dz));
+        }
+
+        // Номер ребёнка для контейнера или 8, если контейнер остаётся в узле
+        static size_t childFor(const BoundingBox<T>& node, const BoundingBox<T>& box){
+            Point<T> mid = middle(node);
+            Point<T> center = middle(box);
+            size_t i = (center.x > mid.x ? 1 : 0) | (center.y > mid.y ? 2 : 0) | (center.z > mid.z ? 4 : 0);
+            BoundingBox<T> child = childBox(node, i);
+            if(box.max.x - box.min.x > child.max.x - child.min.x || box.max.y - box.min.y > child.max.y - child.min.y || box.max.z - box.min.z > child.max.z - child.min.z){
+                return 8;
+            }
+            return i;
+        }
+
+        bool canSplit(const BoundingBox<T>& box, int depth) const{
+            T side = std::max({box.max.x - box.min.x, box.max.y - box.min.y, box.max.z - box.min.z});
+            return depth < policy_.maxDepth && side >= 2 * policy_.minCellSize;
+        }
+
+        static bool at(const BoundingBox<T>& box, ContainerId id){
+            return box.min.x == id.getX() && box.min.y == id.getY() && box.min.z == id.getZ();
+        }
+
+        std::shared_ptr<const Node> insert(const std::shared_ptr<const Node>& node, int depth, const Entry& entry) const{
+            auto copy = std::make_shared<Node>(*node);
+            ++copy->count;
+            size_t i = childFor(copy->box, entry.box);
+            if(!copy->leaf() && i < 8){
+                copy->children[i] = insert(copy->children[i], depth + 1, entry);
+                return copy;
+            }
+            copy->entries.push_back(entry);
+            if(copy->leaf() && copy->entries.size() > policy_.leafCapacity && canSplit(copy->box, depth)){
+                split(*copy, depth);
+            }
+            return copy;
+        }
+
+        // Пакетная сборка сверху вниз, без копирования путей
+        std::shared_ptr<const Node> build(const BoundingBox<T>& box, std::vector<Entry> entries, int depth) const{
+            auto node = std::make_shared<Node>(box);
+            node->count = entries.size();
+            if(entries.size() <= policy_.leafCapacity || !canSplit(box, depth)){
+                node->entries = std::move(entries);
+                return node;
+            }
+            std::array<std::vector<Entry>, 8> parts;
+            for(auto& entry : entries){
+                size_t i = childFor(box, entry.box);
+                if(i < 8){
+                    parts[i].push_back(std::move(entry));
+                }else{
+                    node->entries.push_back(std::move(entry));
+                }
+            }
+            for(size_t i = 0; i < 8; ++i){
+                node->children[i] = build(childBox(box, i), std::move(parts[i]), depth + 1);
+            }
+            return node;
+        }
+
+        void split(Node& node, int depth) const{
+            for(size_t i = 0; i < 8; ++i){
+                node.children[i] = std::make_shared<const Node>(childBox(node.box, i));
+            }
+            std::vector<Entry> stay;
+            for(auto& entry : node.entries){
+                size_t i = childFor(node.box, entry.box);
+                if(i < 8){
+                    node.children[i] = insert(node.children[i], depth + 1, entry);
+                }else{
+                    stay.push_back(entry);
+                }
+            }
+            node.entries = std::move(stay);
+        }
+
+        // nullptr - в поддереве такого контейнера нет, node не меняется
+        std::shared_ptr<const Node> remove(const std::shared_ptr<const Node>& node, ContainerId id, const Point<T>& p) const{
+            auto it = std::find_if(node->entries.begin(), node->entries.end(), [id](const Entry& entry){ return at(entry.box, id); });
+            std::shared_ptr<Node> copy;
+            if(it != node->entries.end()){
+                copy = std::make_shared<Node>(*node);
+                copy->entries.erase(copy->entries.begin() + (it - node->entries.begin()));
+            }else if(!node->leaf()){
+                for(size_t i = 0; i < 8 && copy == nullptr; ++i){
+                    if(node->children[i]->count == 0 || !looseBox(node->children[i]->box).intersects(BoundingBox<T>(p, p))){
+                        continue;
+                    }
+                    auto child = remove(node->children[i], id, p);
+                    if(child != nullptr){
+                        copy = std::make_shared<Node>(*node);
+                        copy->children[i] = child;
+                    }
+                }
+            }
+            if(copy == nullptr){
+                return nullptr;
+            }
+            --copy->count;
+            // Почти пустое поддерево схлопывается в лист
+            if(!copy->leaf() && copy->count <= policy_.mergeCapacity){
+                std::vector<Entry> all;
+                collect(copy, all);
+                copy->entries = std::move(all);
+                copy->children = {};
+            }
+            return copy;
+        }
+
+        static void collect(const std::shared_ptr<const Node>& node, std::vector<Entry>& result){
+            result.insert(result.end(), node->entries.begin(), node->entries.end());
+            if(!node->leaf()){
+                for(auto& child : node->children){
+                    collect(child, result);
+                }
+            }
+        }
+
+        // fn возвращает false, чтобы остановить обход; результат - обход дошёл до конца
+        template <typename F>
+        static bool visit(const std::shared_ptr<const Node>& node, const BoundingBox<T>& box, F& fn){
+            for(auto& entry : node->entries){
+                if(entry.box.intersects(box) && !fn(entry)){
+                    return false;
+                }
+            }
+            if(!node->leaf()){
+                for(auto& child : node->children){
+                    if(child->count != 0 && looseBox(child->box).intersects(box) && !visit(child, box, fn)){
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Обходит все записи на месте, без промежуточного вектора
+        template <typename F>
+        static void visitAll(const std::shared_ptr<const Node>& node, F& fn){
+            for(auto& entry : node->entries){
+                fn(entry.box, entry.item);
+            }
+            if(!node->leaf()){
+                for(auto& child : node->children){
+                    if(child->count != 0){
+                        visitAll(child, fn);
+                    }
+                }
+            }
+        }
+
+        static void nodes(const std::shared_ptr<const Node>& node, std::unordered_set<const Node*>& result){
+            result.insert(node.get());
+            if(!node->leaf()){
+                for(auto& child : node->children){
+                    nodes(child, result);
+                }
+            }
+        }
+
+    public:
+        PersistentOctree() : root(std::make_shared<const Node>(BoundingBox<T>(Point<T>(0, 0, 0), Point<T>(0, 0, 0)))) {}
+
+        explicit PersistentOctree(const BoundingBox<T>& bound, SplitPolicy<T> policy = SplitPolicy<T>())
+            : root(std::make_shared<const Node>(bound)), policy_(policy) {
+            policy_.validate();
+        }
+
+        PersistentOctree(const BoundingBox<T>& bound, SplitPolicy<T> policy, std::vector<Entry> entries) : policy_(policy) {
+            policy_.validate();
+            root = build(bound, std::move(entries), 0);
+        }
+
+        void insert(const BoundingBox<T>& box, N item){
+            root = insert(root, 0, Entry{box, std::move(item)});
+        }
+
+        // Контейнер ищется по нижнему углу - так же, как ContainerId
+        bool remove(ContainerId id){
+            auto updated = remove(root, id, Point<T>(id.getX(), id.getY(), id.getZ()));
+            if(updated == nullptr){
+                return false;
+            }
+            root = updated;
+            return true;
+        }
+
+        const Entry* find(ContainerId id) const{
+            const Entry* result = nullptr;
+            Point<T> p(id.getX(), id.getY(), id.getZ());
+            auto match = [&result, id](const Entry& entry){
+                if(at(entry.box, id)){
+                    result = &entry;
+                    return false;
+                }
+                return true;
+            };
+            visit(root, BoundingBox<T>(p, p), match);
+            return result;
+        }
+
+        // Касание гранями считается пересечением, как в Octree
+        template <typename F>
+        void queryBox(const BoundingBox<T>& box, F fn) const{
+            auto each = [&fn](const Entry& entry){
+                fn(entry.box, entry.item);
+                return true;
+            };
+            visit(root, box, each);
+        }
+
+        bool collides(const BoundingBox<T>& box) const{
+            auto stop = [](const Entry&){ return false; };
+            return !visit(root, box, stop);
+        }
+
+        template <typename F>
+        void forEachEntry(F fn) const{
+            visitAll(root, fn);
+        }
+
+        size_t size() const{
+            return root->count;
+        }
+
+        const BoundingBox<T>& bound() const{
+            return root->box;
+        }
+
+        // Сколько узлов этой версии не разделено с other - цена её отличий
+        size_t uniqueNodes(const PersistentOctree& other) const{
+            std::unordered_set<const Node*> shared;
+            nodes(other.root, shared);
+            std::unordered_set<const Node*> own;
+            nodes(root, own);
+            return std::count_if(own.begin(), own.end(), [&shared](const Node* node){ return shared.count(node) == 0; });
+        }
+};
+
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef PUBLISHEDINDEX_HPP
+#define PUBLISHEDINDEX_HPP
+
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "EpochDomain.hpp"
+#include "../Container/I/ContainerId.hpp"
+
+
+// Индекс id -> (позиция, контейнер) для чтения без блокировок. Разбит на ShardCount
+// неизменяемых частей; писатель копирует одну часть с изменением, публикует копию
+// атомарной заменой указателя и отдаёт старую в EpochDomain. Запись стоит
+// O(n / ShardCount), поиск - одна загрузка указателя и поиск в хэш-таблице.
+// Писатели идут по одному (снаружи под эксклюзивной блокировкой), читатели - как угодно.
+// Старые части освобождаются пачками по CollectBatch, так что между сборками
+// в памяти держится до CollectBatch лишних копий частей. Копия части на каждую
+// запись остаётся: индекс рассчитан на склад, который читают много чаще, чем меняют.
+// Если одновременных читателей больше EpochDomain::Slots, лишние получают Off.
+template <typename CPosType, typename N>
+class PublishedIndex{
+    public:
+        static constexpr size_t ShardCount = 64;
+        static constexpr size_t CollectBatch = 32;
+        using Shard = std::unordered_map<ContainerId, std::pair<CPosType, N>>;
+
+        enum class Lookup{
+            Found,
+            Missing,
+            Off     // индекс выключен, отвечать должен основной путь под блокировкой
+        };
+
+    private:
+        mutable EpochDomain epochs;
+        std::array<std::atomic<const Shard*>, ShardCount> shards{};
+        std::atomic<bool> active{false};
+
+        static size_t shardOf(ContainerId id){
+            return std::hash<ContainerId>()(id) % ShardCount;
+        }
+
+        // Возвращает, сколько снятых частей ждут освобождения
+        size_t publish(size_t i, const Shard* shard){
+            const Shard* old = shards[i].exchange(shard);
+            return old == nullptr ? 0 : epochs.retire(old);
+        }
+
+        void publishWrite(size_t i, const Shard* shard){
+            if(publish(i, shard) >= CollectBatch){
+                epochs.collect();
+            }
+        }
+
+    public:
+        PublishedIndex() = default;
+        PublishedIndex(const PublishedIndex&) = delete;
+        PublishedIndex& operator=(const PublishedIndex&) = delete;
+
+        ~PublishedIndex(){
+            for(auto& shard : shards){
+                delete shard.load();
+            }
+        }
+
+        bool enabled() const{
+            return active.load();
+        }
+
+        // Включает индекс и заполняет его заново
+        void rebuild(const std::vector<std::pair<CPosType, N>>& items){
+            std::array<Shard*, ShardCount> fresh;
+            for(auto& shard : fresh){
+                shard = new Shard();
+            }
+            for(auto& item : items){
+                ContainerId id(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z);
+                fresh[shardOf(id)]->emplace(id, item);
+            }
+            for(size_t i = 0; i < ShardCount; ++i){
+                publish(i, fresh[i]);
+            }
+            active.store(true);
+            epochs.collect();
+        }
+
+        void disable(){
+            active.store(false);
+            for(size_t i = 0; i < ShardCount; ++i){
+                publish(i, nullptr);
+            }
+            epochs.collect();
+        }
+
+        void put(ContainerId id, const CPosType& position, N item){
+            size_t i = shardOf(id);
+            const Shard* current = shards[i].load();
+            Shard* copy = current == nullptr ? new Shard() : new Shard(*current);
+            (*copy)[id] = std::make_pair(position, std::move(item));
+            publishWrite(i, copy);
+        }
+
+        void erase(ContainerId id){
+            size_t i = shardOf(id);
+            const Shard* current = shards[i].load();
+            if(current == nullptr || current->find(id) == current->end()){
+                return;
+            }
+            Shard* copy = new Shard(*current);
+            copy->erase(id);
+            publishWrite(i, copy);
+        }
+
+        Lookup find(ContainerId id, std::pair<CPosType, N>& result) const{
+            EpochDomain::Guard guard(epochs);
+            if(!guard.pinned()){
+                return Lookup::Off;
+            }
+            const Shard* shard = shards[shardOf(id)].load();
+            if(shard == nullptr || !active.load()){
+                return Lookup::Off;
+            }
+            auto it = shard->find(id);
+            if(it == shard->end()){
+                return Lookup::Missing;
+            }
+            result = it->second;
+            return Lookup::Found;
+        }
+
+        // Сколько снятых частей ещё ждут освобождения
+        size_t pending() const{
+            return epochs.pending();
+        }
+};
+
+
+#endif
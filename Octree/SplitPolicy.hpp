@@ -0,0 +1,39 @@
+#ifndef SPLITPOLICY_HPP
+#define SPLITPOLICY_HPP
+
+
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+#include "BoundingBox.hpp"
+
+
+// Правила деления и слияния узлов октодерева. Глубина дерева не задаётся заранее:
+// лист делится, только пока в нём много контейнеров, и останавливается на maxDepth
+// или когда ячейка становится меньше minCellSize.
+template <typename T>
+struct SplitPolicy{
+    size_t leafCapacity = 4;   // лист делится, когда в нём больше leafCapacity контейнеров
+    int maxDepth = 16;         // глубже этого уровня узлы не делятся
+    T minCellSize = 1;         // ячейку меньше 2 * minCellSize по наибольшей стороне не делим
+    size_t mergeCapacity = 2;  // поддерево схлопывается, когда в нём не больше mergeCapacity контейнеров
+
+    void validate() const{
+        if(leafCapacity == 0 || maxDepth < 0 || minCellSize <= 0){
+            throw std::invalid_argument("Invalid octree split policy");
+        }
+        // Порог слияния ниже порога деления, иначе узел будет делиться и сливаться
+        // на каждой вставке и удалении около границы
+        if(mergeCapacity >= leafCapacity){
+            throw std::invalid_argument("Merge capacity must be less than leaf capacity");
+        }
+    }
+
+    bool canSplit(const BoundingBox<T>& cell) const{
+        T extent = std::max({cell.max.x - cell.min.x, cell.max.y - cell.min.y, cell.max.z - cell.min.z});
+        return extent / 2 >= minCellSize;
+    }
+};
+
+
+#endif
@@ -26,27 +26,31 @@ class Request{
             std::uniform_int_distribution<int> RotateMethodDist(0, 5);
             std::uniform_int_distribution<int> indexDist(0, 100);
             std::vector<std::string> id;
+            size_t count = 0;
             for(size_t i = 0; i < 30; ++i){
+                if(actionDist(gen) == 0){
+                    ++count;
+                }
+            }
+            // Контейнеры приходят партией; не вставшие заменяются новыми, пока не встанут все
+            size_t added = 0;
+            while(added < count){
                 try{
-                    int action = actionDist(gen);
-                    if(action == 0){
-                        std::shared_ptr<IContainer> c = std::make_shared<Container>("0", "Andre", DimensionsDist(gen), DimensionsDist(gen), 1, (double)(DimensionsDist(gen)), (double)(DimensionsDist(gen)));
-                        std::string flag = storage.addContainer(c);
-                        if(flag == "_"){
-                            //std::cerr << "Error in RequestQ: Can't add container with this index" << std::endl;
-                            --i;
-                        }else{
+                    std::vector<std::shared_ptr<IContainer>> batch;
+                    for(size_t i = added; i < count; ++i){
+                        batch.push_back(std::make_shared<Container>("0", "Andre", DimensionsDist(gen), DimensionsDist(gen), 1, (double)(DimensionsDist(gen)), (double)(DimensionsDist(gen))));
+                    }
+                    for(auto& result : storage.addContainers(batch)){
+                        if(result.status == PlaceStatus::Ok){
+                            ++added;
                             std::cout << "Container added successfully" << std::endl;
                         }
-                        storage.getInfo();
-                       std::cout << "\n-------------------------------\n" << std::endl;
-                       std::cout << storage.getInfo() << std::endl;
-                    } 
+                    }
+                    std::cout << "\n-------------------------------\n" << std::endl;
+                    std::cout << storage.getInfo() << std::endl;
                 }catch(std::exception& e){
                     std::cerr << "Error in RequestQ: " << e.what() << std::endl;
-                    --i;
                 }
-                //std::this_thread::sleep_for(std::chrono::milliseconds(500)); не надо здесь
             }
             bool flag = false;
             for(int i = 0; i < 3; ++i){
@@ -0,0 +1,35 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+
+#include <memory>
+#include "../Container/I/IContainer.hpp"
+#include "../Checker/PlaceStatus.hpp"
+#include "PlacementStrategy.hpp"
+
+
+// Порядок, в котором addContainers размещает партию. Внутри группы крупные
+// контейнеры идут первыми, равные сохраняют порядок партии.
+enum class BatchOrder{
+    AsGiven,
+    Volume,        // по убыванию объёма
+    Fragility,     // сначала нехрупкие, чтобы хрупкие оказались сверху
+    Refrigeration  // сначала рефрижераторные
+};
+
+
+struct BatchPolicy{
+    BatchOrder order = BatchOrder::Volume;
+    PlacementStrategy strategy = PlacementStrategy::FirstFit;
+};
+
+
+// Итог размещения одного контейнера партии, в порядке исходной партии
+struct BatchResult{
+    std::shared_ptr<IContainer> container;
+    ContainerId id;
+    PlaceStatus status = PlaceStatus::NoPlace;
+};
+
+
+#endif
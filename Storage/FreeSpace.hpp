@@ -0,0 +1,85 @@
+#ifndef FREESPACE_HPP
+#define FREESPACE_HPP
+
+
+#include <set>
+#include <tuple>
+#include <vector>
+#include "../Octree/BoundingBox.hpp"
+
+
+// Точки-кандидаты (extreme points) для автоматического размещения: нижние углы,
+// в которые может встать следующий контейнер. Появляются у граней уже стоящих
+// контейнеров и исчезают, когда их накрывает новый контейнер. Упорядочены
+// по (y, x, z) - в том же порядке, в каком раньше шёл перебор всех координат.
+class FreeSpace{
+    public:
+        struct Order{
+            bool operator()(const Point<int>& a, const Point<int>& b) const{
+                return std::tie(a.y, a.x, a.z) < std::tie(b.y, b.x, b.z);
+            }
+        };
+
+    private:
+        std::set<Point<int>, Order> points;
+        int length = 0, width = 0, height = 0;
+
+    public:
+        FreeSpace() = default;
+
+        FreeSpace(int length, int width, int height) : length(length), width(width), height(height) {
+            reset();
+        }
+
+        // Пустой склад: единственный кандидат - угол (1, 1, 1)
+        void reset(){
+            points.clear();
+            add(Point<int>(1, 1, 1));
+        }
+
+        void clear(){
+            points.clear();
+        }
+
+        // Точки за пределами склада не храним: контейнер туда всё равно не встанет
+        void add(const Point<int>& p){
+            if(p.x >= 1 && p.x < length && p.y >= 1 && p.y < width && p.z >= 1 && p.z < height){
+                points.insert(p);
+            }
+        }
+
+        void erase(const Point<int>& p){
+            points.erase(p);
+        }
+
+        // Убирает кандидатов, оказавшихся внутри занятого бокса (границы включительно)
+        void eraseInside(const BoundingBox<int>& box){
+            auto it = points.lower_bound(Point<int>(box.min.x, box.min.y, box.min.z));
+            while(it != points.end() && it->y <= box.max.y){
+                if(it->x >= box.min.x && it->x <= box.max.x && it->z >= box.min.z && it->z <= box.max.z){
+                    it = points.erase(it);
+                }else{
+                    ++it;
+                }
+            }
+        }
+
+        std::vector<Point<int>> candidates() const{
+            return std::vector<Point<int>>(points.begin(), points.end());
+        }
+
+        size_t size() const{
+            return points.size();
+        }
+
+        auto begin() const{
+            return points.begin();
+        }
+
+        auto end() const{
+            return points.end();
+        }
+};
+
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef HEIGHTMAP_HPP
+#define HEIGHTMAP_HPP
+
+
+#include <vector>
+#include <algorithm>
+#include "../Octree/BoundingBox.hpp"
+#include "../Container/I/ContainerId.hpp"
+
+
+// Карта высот склада: для каждой клетки (x, y) - верх самого высокого контейнера,
+// накрывающего её, и id этого контейнера. top = 0 - клетка пуста.
+// Под навесом (контейнер выше с зазором) карта видит только верхний контейнер,
+// поэтому вопросы про то, что ниже верха столбца, решает октодерево.
+class Heightmap{
+    public:
+        struct Cell{
+            int top = 0;
+            ContainerId id;
+        };
+
+    private:
+        int length = 0, width = 0;
+        std::vector<Cell> cells;
+
+        // Пересечение footprint с сеткой склада, границы включительно
+        bool clip(const BoundingBox<int>& box, int& x0, int& y0, int& x1, int& y1) const{
+            x0 = std::max(box.min.x, 0);
+            y0 = std::max(box.min.y, 0);
+            x1 = std::min(box.max.x, length);
+            y1 = std::min(box.max.y, width);
+            return x0 <= x1 && y0 <= y1;
+        }
+
+    public:
+        Heightmap() = default;
+
+        Heightmap(int length, int width) : length(length), width(width), cells(static_cast<size_t>(length + 1) * (width + 1)) {}
+
+        const Cell& at(int x, int y) const{
+            static const Cell empty;
+            if(x < 0 || y < 0 || x > length || y > width){
+                return empty;
+            }
+            return cells[static_cast<size_t>(y) * (length + 1) + x];
+        }
+
+        // Контейнер box становится верхом тех клеток, где он выше текущего верха
+        void raise(const BoundingBox<int>& box, ContainerId id){
+            int x0, y0, x1, y1;
+            if(!clip(box, x0, y0, x1, y1)){
+                return;
+            }
+            for(int y = y0; y <= y1; ++y){
+                Cell* row = &cells[static_cast<size_t>(y) * (length + 1)];
+                for(int x = x0; x <= x1; ++x){
+                    if(box.max.z > row[x].top){
+                        row[x].top = box.max.z;
+                        row[x].id = id;
+                    }
+                }
+            }
+        }
+
+        void clear(const BoundingBox<int>& box){
+            int x0, y0, x1, y1;
+            if(!clip(box, x0, y0, x1, y1)){
+                return;
+            }
+            for(int y = y0; y <= y1; ++y){
+                std::fill_n(&cells[static_cast<size_t>(y) * (length + 1) + x0], x1 - x0 + 1, Cell());
+            }
+        }
+
+        // Самый высокий верх под footprint, 0 - под ним пусто
+        int maxTop(const BoundingBox<int>& box) const{
+            int x0, y0, x1, y1;
+            int result = 0;
+            if(!clip(box, x0, y0, x1, y1)){
+                return result;
+            }
+            for(int y = y0; y <= y1; ++y){
+                const Cell* row = &cells[static_cast<size_t>(y) * (length + 1)];
+                for(int x = x0; x <= x1; ++x){
+                    result = std::max(result, row[x].top);
+                }
+            }
+            return result;
+        }
+
+        // Сколько клеток под footprint имеют верх ровно z
+        size_t countTop(const BoundingBox<int>& box, int z) const{
+            int x0, y0, x1, y1;
+            size_t result = 0;
+            if(!clip(box, x0, y0, x1, y1)){
+                return result;
+            }
+            for(int y = y0; y <= y1; ++y){
+                const Cell* row = &cells[static_cast<size_t>(y) * (length + 1)];
+                result += std::count_if(row + x0, row + x1 + 1, [z](const Cell& cell){ return cell.top == z; });
+            }
+            return result;
+        }
+
+        // Высота, на которую опустится контейнер с таким footprint, если бросить его сверху
+        int restZ(const BoundingBox<int>& box) const{
+            return maxTop(box) + 1;
+        }
+};
+
+
+#endif
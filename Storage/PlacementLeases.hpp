@@ -0,0 +1,135 @@
+#ifndef PLACEMENTLEASES_HPP
+#define PLACEMENTLEASES_HPP
+
+
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "../Octree/BoundingBox.hpp"
+
+
+// Аренда места под автоматическое размещение: поиск выбирает кандидата,
+// арендует его бокс и только потом вставляет контейнер. Пока аренда жива,
+// другие поиски пропускают кандидатов, задевающих её (касание тоже считается),
+// поэтому параллельные размещения не выбирают одно и то же место.
+class PlacementLeases{
+    public:
+        // Держит бокс до release или разрушения; пустая - аренда не досталась
+        class Lease{
+            private:
+                PlacementLeases* owner = nullptr;
+                uint64_t ticket = 0;
+
+            public:
+                Lease() = default;
+                Lease(PlacementLeases* owner, uint64_t ticket) : owner(owner), ticket(ticket) {}
+                Lease(const Lease&) = delete;
+                Lease& operator=(const Lease&) = delete;
+                Lease(Lease&& other) noexcept : owner(other.owner), ticket(other.ticket) {
+                    other.owner = nullptr;
+                }
+                Lease& operator=(Lease&& other) noexcept{
+                    if(this != &other){
+                        release();
+                        owner = other.owner;
+                        ticket = other.ticket;
+                        other.owner = nullptr;
+                    }
+                    return *this;
+                }
+
+                ~Lease(){
+                    release();
+                }
+
+                void release(){
+                    if(owner != nullptr){
+                        owner->release(ticket);
+                        owner = nullptr;
+                    }
+                }
+
+                explicit operator bool() const{
+                    return owner != nullptr;
+                }
+        };
+
+    private:
+        struct Entry{
+            uint64_t ticket;
+            BoundingBox<int> box;
+        };
+
+        mutable std::mutex mtx;
+        std::condition_variable_any released;
+        std::vector<Entry> entries;
+        std::atomic<size_t> count{0};
+        std::atomic<uint64_t> releaseCount{0};
+        uint64_t nextTicket = 1;
+
+        static bool touches(const BoundingBox<int>& a, const BoundingBox<int>& b){
+            return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+                   a.min.y <= b.max.y && a.max.y >= b.min.y &&
+                   a.min.z <= b.max.z && a.max.z >= b.min.z;
+        }
+
+        void release(uint64_t ticket){
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = std::find_if(entries.begin(), entries.end(), [ticket](const Entry& entry){ return entry.ticket == ticket; });
+            if(it != entries.end()){
+                *it = entries.back();
+                entries.pop_back();
+                count.store(entries.size());
+                ++releaseCount;
+            }
+            released.notify_all();
+        }
+
+    public:
+        PlacementLeases() = default;
+        PlacementLeases(const PlacementLeases&) = delete;
+        PlacementLeases& operator=(const PlacementLeases&) = delete;
+
+        Lease acquire(const BoundingBox<int>& box){
+            std::lock_guard<std::mutex> lock(mtx);
+            for(auto& entry : entries){
+                if(touches(entry.box, box)){
+                    return Lease();
+                }
+            }
+            entries.push_back(Entry{nextTicket, box});
+            count.store(entries.size());
+            return Lease(this, nextTicket++);
+        }
+
+        // Задевает ли box чью-то живую аренду; без аренд обходится без блокировки
+        bool leased(const BoundingBox<int>& box) const{
+            if(count.load() == 0){
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            return std::any_of(entries.begin(), entries.end(), [&box](const Entry& entry){ return touches(entry.box, box); });
+        }
+
+        size_t size() const{
+            return count.load();
+        }
+
+        // Сколько аренд уже освобождено; снимок для waitRelease
+        uint64_t releases() const{
+            return releaseCount.load();
+        }
+
+        // Ждёт, пока после снимка seen освободится хоть одна аренда, или отмены
+        void waitRelease(uint64_t seen, std::stop_token token){
+            std::unique_lock<std::mutex> lock(mtx);
+            released.wait(lock, token, [this, seen](){ return releaseCount.load() != seen; });
+        }
+};
+
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PLACEMENTSTRATEGY_HPP
+#define PLACEMENTSTRATEGY_HPP
+
+
+#include <memory>
+#include <functional>
+#include "../Container/I/IContainer.hpp"
+#include "../Octree/ContainerPosition.hpp"
+
+
+class Storage;
+
+
+// Правило выбора точки при автоматическом размещении. Кандидаты всегда берутся
+// из точек FreeSpace, стратегия решает только, какая из подходящих лучше.
+enum class PlacementStrategy{
+    FirstFit,       // первая подходящая в порядке (y, x, z)
+    BottomLeftBack, // минимальная (z, x, y): как можно ниже, левее и ближе
+    BestFit,        // наибольшая площадь касания с полом, стенами и соседями
+    LowestHeight,   // самый низкий верх контейнера
+    RandomRestart   // первая подходящая, но перебор каждый раз в случайном порядке
+};
+
+
+// Оценка подходящей позиции, меньше - лучше. При равных оценках побеждает
+// кандидат раньше в порядке FreeSpace. Вызывается из потоков пула одновременно,
+// поэтому не должна менять склад.
+using PlacementScore = std::function<double(Storage&, std::shared_ptr<IContainer>, const ContainerPosition<int>&)>;
+
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef REGIONLOCKS_HPP
+#define REGIONLOCKS_HPP
+
+
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+
+// Замки на полосы пола склада вдоль x. Писатель берёт все полосы, которые
+// задевает его контейнер (с запасом в клетку на касание) и опора под ним,
+// всегда по возрастанию номера, поэтому взаимных блокировок нет.
+// Вставки в непересекающиеся полосы проверяются параллельно.
+class RegionLocks{
+    public:
+        static constexpr int DefaultBands = 8;
+
+        // Держит полосы [first, last] до unlock или разрушения
+        class Guard{
+            private:
+                RegionLocks* owner = nullptr;
+                int first = 0, last = -1;
+
+            public:
+                Guard(RegionLocks& locks, int first, int last) : owner(&locks), first(first), last(last) {
+                    for(int i = first; i <= last; ++i){
+                        owner->bands[i].lock();
+                    }
+                }
+                Guard(const Guard&) = delete;
+                Guard& operator=(const Guard&) = delete;
+                Guard(Guard&& other) noexcept : owner(other.owner), first(other.first), last(other.last) {
+                    other.owner = nullptr;
+                }
+                Guard& operator=(Guard&& other) noexcept{
+                    if(this != &other){
+                        unlock();
+                        owner = other.owner;
+                        first = other.first;
+                        last = other.last;
+                        other.owner = nullptr;
+                    }
+                    return *this;
+                }
+
+                ~Guard(){
+                    unlock();
+                }
+
+                void unlock(){
+                    if(owner != nullptr){
+                        for(int i = last; i >= first; --i){
+                            owner->bands[i].unlock();
+                        }
+                        owner = nullptr;
+                    }
+                }
+        };
+
+    private:
+        int count = DefaultBands;
+        int width = 1;
+        std::unique_ptr<std::mutex[]> bands = std::make_unique<std::mutex[]>(DefaultBands);
+
+        int band(int x) const{
+            return std::clamp(x / width, 0, count - 1);
+        }
+
+    public:
+        RegionLocks() = default;
+        RegionLocks(const RegionLocks&) = delete;
+        RegionLocks& operator=(const RegionLocks&) = delete;
+
+        // Полосы делят длину склада поровну; звать, только пока полосы никто не держит
+        void resize(int length){
+            width = std::max(1, (length + count) / count);
+        }
+
+        int bandCount() const{
+            return count;
+        }
+
+        int bandOf(int x) const{
+            return band(x);
+        }
+
+        Guard lock(int minX, int maxX){
+            return Guard(*this, band(minX), band(maxX));
+        }
+};
+
+
+#endif
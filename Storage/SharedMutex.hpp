@@ -0,0 +1,56 @@
+#ifndef SHAREDMUTEX_HPP
+#define SHAREDMUTEX_HPP
+
+
+#include <mutex>
+#include <shared_mutex>
+
+
+// shared_mutex, в котором читатели не могут бесконечно обгонять писателя:
+// ждущий писатель держит turnstile, и новые читатели встают за ним.
+// std::shared_mutex в glibc отдаёт предпочтение читателям, и при постоянном
+// опросе склада изменения не проходили бы вовсе.
+class SharedMutex{
+    private:
+        std::mutex turnstile;
+        std::shared_mutex mutex;
+
+    public:
+        void lock(){
+            std::lock_guard<std::mutex> gate(turnstile);
+            mutex.lock();
+        }
+
+        bool try_lock(){
+            std::unique_lock<std::mutex> gate(turnstile, std::try_to_lock);
+            return gate.owns_lock() && mutex.try_lock();
+        }
+
+        void unlock(){
+            mutex.unlock();
+        }
+
+        void lock_shared(){
+            {
+                std::lock_guard<std::mutex> gate(turnstile);
+            }
+            mutex.lock_shared();
+        }
+
+        bool try_lock_shared(){
+            {
+                std::unique_lock<std::mutex> gate(turnstile, std::try_to_lock);
+                if(!gate.owns_lock()){
+                    return false;
+                }
+            }
+            return mutex.try_lock_shared();
+        }
+
+        void unlock_shared(){
+            mutex.unlock_shared();
+        }
+};
+
+
+#endif
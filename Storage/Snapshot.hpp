@@ -0,0 +1,110 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include "../Container/I/IContainer.hpp"
+#include "../Checker/PlaceStatus.hpp"
+#include "../Octree/Octree.hpp"
+#include "../Octree/PersistentOctree.hpp"
+
+
+// Снимок склада на момент Storage::snapshot(): берётся за O(1) и дальше от склада
+// не зависит. Подходит для согласованных отчётов и проверок "что если": tryAdd и
+// remove меняют только снимок и копируют лишь путь дерева до затронутого узла.
+// Проверяются габариты, пересечения и опора; Checker склада здесь не вызывается.
+// Объекты контейнеров общие со складом, позицию в снимке даёт только сам снимок.
+class StorageSnapshot{
+    public:
+        using Tree = PersistentOctree<int, std::shared_ptr<IContainer>>;
+
+    private:
+        Tree tree;
+        int length, width, height;
+
+        static ContainerPosition<int> toPosition(const BoundingBox<int>& box){
+            return Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toPosition(box);
+        }
+
+        // Как Storage::supportedAt: под точкой крыша ровно на высоте p.z
+        bool supportedAt(const Point<int>& p) const{
+            bool supported = false;
+            tree.queryBox(BoundingBox<int>(p, p), [&supported, &p](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>&){
+                supported = supported || entry.max.z == p.z;
+            });
+            return supported;
+        }
+
+    public:
+        StorageSnapshot(Tree tree, int length, int width, int height) : tree(std::move(tree)), length(length), width(width), height(height) {}
+
+        size_t size() const{
+            return tree.size();
+        }
+
+        int getLength() const{
+            return length;
+        }
+
+        int getWidth() const{
+            return width;
+        }
+
+        int getHeight() const{
+            return height;
+        }
+
+        std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> find(ContainerId id) const{
+            const Tree::Entry* entry = tree.find(id);
+            if(entry == nullptr){
+                throw std::runtime_error("Container not found");
+            }
+            return std::make_pair(toPosition(entry->box), entry->item);
+        }
+
+        std::vector<ContainerId> getListContainerIds() const{
+            std::vector<ContainerId> result;
+            result.reserve(tree.size());
+            tree.forEachEntry([&result](const BoundingBox<int>& box, const std::shared_ptr<IContainer>&){
+                result.emplace_back(box.min.x, box.min.y, box.min.z);
+            });
+            return result;
+        }
+
+        PlaceStatus tryAdd(std::shared_ptr<IContainer> container, int X, int Y, int Z){
+            if(X < 1 || Y < 1 || Z < 1){
+                return PlaceStatus::InvalidCoordinates;
+            }
+            if(container == nullptr){
+                return PlaceStatus::InvalidContainer;
+            }
+            BoundingBox<int> box(Point<int>(X, Y, Z), Point<int>(X + container->getLength(), Y + container->getWidth(), Z + container->getHeight()));
+            if(box.max.x >= length || box.max.y >= width || box.max.z >= height || tree.collides(box)){
+                return PlaceStatus::NoPlace;
+            }
+            if(Z != 1){
+                int midY = box.min.y + (box.max.y - box.min.y) / 2;
+                bool supported = supportedAt(Point<int>(box.min.x + (box.max.x - box.min.x) / 2, midY, Z - 1)) ||
+                                 (supportedAt(Point<int>(box.min.x, midY, Z - 1)) && supportedAt(Point<int>(box.max.x, midY, Z - 1)));
+                if(!supported){
+                    bool below = tree.collides(BoundingBox<int>(Point<int>(box.min.x, box.min.y, 0), Point<int>(box.max.x, box.max.y, Z - 1)));
+                    return below ? PlaceStatus::NoSupport : PlaceStatus::CantFly;
+                }
+            }
+            tree.insert(box, container);
+            return PlaceStatus::Ok;
+        }
+
+        bool remove(ContainerId id){
+            return tree.remove(id);
+        }
+
+        const Tree& getTree() const{
+            return tree;
+        }
+};
+
+
+#endif
@@ -8,108 +8,118 @@
 #include <numeric>
 #include <cmath>
 #include <vector>
-
-
-int Storage::calculateDepth(){
-    auto countDivisionsByTwo = [](int num) {
-        int count = 0;
-        while (num > 0 && num % 2 == 0) {
-            num /= 2;
-            count++;
-        }
-        return count;
-    };
-    return std::min({countDivisionsByTwo(length), countDivisionsByTwo(width), countDivisionsByTwo(height)});
-    
-}
+#include <limits>
+#include <sstream>
 
 
   void Storage::addExternalCheckFunction(const std::function<void(Storage&, std::shared_ptr<IContainer>, ContainerPosition<int>)>& externalFunc) {
+        WriteLock lock(shared_mtx);
         checker.addCheckFunction(externalFunc);
     }
 
 
-Storage::Storage(int number, int length, int width, int height, double temperature) : checker(){
+Storage::Storage(int number, int length, int width, int height, double temperature, SplitPolicy<int> policy) : checker(), splitPolicy(policy){
     this->number = number;
     this->length = length;
     this->width = width;
     this->height = height;
     this->temperature = temperature;
     BoundingBox<int> bound(Point<int>(-1, -1, -1), Point<int>(length, width, height));
-    this->containers = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>(bound, calculateDepth());
-    this->checker.addCheckFunction([this](Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position) {
-        checkTemperature(storage, container, position);
-    });
-    this->checker.addCheckFunction([this](Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position) {
-        checkPressure(storage, container, position);
-    });
-}
-
-
-bool Storage::comparePosition(std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos1, std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos2){
-    return pos1.first.LLDown.z < pos2.first.LLDown.z;
-}
-
-
-bool Storage::comparePositionReverse(std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos1, std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos2){
-    return pos1.first.LLDown.z > pos2.first.LLDown.z;
+    this->containers = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>(bound, splitPolicy);
+    this->freeSpace = FreeSpace(length, width, height);
+    this->heightmap = Heightmap(length, width);
+    this->regions.resize(length);
+    this->checker.addStatusFunction(checkTemperature);
+    this->checker.addStatusFunction(checkPressure);
 }
 
 
 Storage& Storage::operator=(const Storage& other) {
         if (this != &other) { 
+            WriteLock lock(shared_mtx, std::defer_lock);
+            SharedLock otherLock(other.shared_mtx, std::defer_lock);
+            std::lock(lock, otherLock);
+            SharedLock otherStructure(other.structure_mtx);
             number = other.number;
             length = other.length;
             width = other.width;
             height = other.height;
             temperature = other.temperature;
-            containers = (other).containers.Clone();
-            auto i = other.containers.searchDepth();
-            std::sort(i.begin(), i.end(), comparePosition);
-            for(auto& it : i){
-                addContainer(it.second->Clone(), it.first.LLDown.x, it.first.LLDown.y, it.first.LLDown.z);
-            }
-            Checker checker = other.checker;
+            splitPolicy = other.splitPolicy;
+            pool = other.pool;
+            placement = other.placement;
+            regions.resize(length);
+            checker = other.checker;
+            loadContainers(other.containers.searchDepth(), true);
         }
         return *this;
     }
 
 
-Storage::Storage(const Storage& other)
-        : number(other.number), length(other.length), width(other.width), height(other.height), temperature(other.temperature) {
-        containers = other.containers.Clone(); // Используем интерфейс Clone для копирования
-        auto i = other.containers.searchDepth();
-        std::sort(i.begin(), i.end(), comparePosition);
-        for(auto it : i){
-            std::cout << it.second->getId() << std::endl;
-        }
-        for(auto& it : i){
-            try{
-            addContainer(it.second->Clone(), it.first.LLDown.x, it.first.LLDown.y, it.first.LLDown.z);
-            }catch(std::exception& e){
-                std::cout << "Error hahahaha: " << e.what() << std::endl;
-                std::cout << it.second->getId() << std::endl;
-            }
-        }
-        Checker checker = other.checker;
+Storage::Storage(const Storage& other) : Storage(other, true) {}
+
+
+// cloneItems = false - контейнеры общие с other; годится для копий, в которых
+// только добавляют новые контейнеры и ничего не двигают
+Storage::Storage(const Storage& other, bool cloneItems){
+        ReadLock otherLock(other);
+        number = other.number;
+        length = other.length;
+        width = other.width;
+        height = other.height;
+        temperature = other.temperature;
+        splitPolicy = other.splitPolicy;
+        pool = other.pool;
+        placement = other.placement;
+        regions.resize(length);
+        checker = other.checker;
+        loadContainers(other.containers.searchDepth(), cloneItems);
     }
 
 
 void Storage::getSize(int l, int w, int h){
+    WriteLock lock(shared_mtx);
     if(l < length || w < width || h < height){
         throw std::runtime_error("Storage l|w|h must be greater than or equal to length|width|height");
     }
-    Storage newStorage(this->number, l, w, h, this->temperature);
     auto i = this->containers.searchDepth();
-    std::sort(i.begin(), i.end(), comparePosition);
-    for(auto& it : i){
-        std::cout << it.second->getId() << std::endl;
+    length = l;
+    width = w;
+    height = h;
+    regions.resize(length);
+    // Координаты контейнеров не меняются, поэтому те же объекты просто переносятся в новое дерево
+    loadContainers(i, false);
+}
+
+
+// Все контейнеры уже прошли проверки при размещении, поэтому дерево
+// собирается пакетно, без SearchInsert, Checker и постепенных split
+void Storage::loadContainers(const std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>>& items, bool clone){
+    std::vector<std::pair<BoundingBox<int>, std::shared_ptr<IContainer>>> entries;
+    entries.reserve(items.size());
+    for(auto& it : items){
+        entries.emplace_back(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(it.first), clone ? it.second->Clone() : it.second);
     }
-    for(auto& it : i){
-        newStorage.addContainer(it.second->Clone(), it.first.LLDown.x, it.first.LLDown.y, it.first.LLDown.z);
+    BoundingBox<int> bound(Point<int>(-1, -1, -1), Point<int>(length, width, height));
+    containers = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>(bound, splitPolicy, std::move(entries), pool.get());
+    rebuildHeightmap();
+    rebuildFreeSpace();
+    rebuildSupportGraph();
+    versions = StorageSnapshot::Tree();
+    versionsBuilt = false;
+    if(published.enabled()){
+        published.rebuild(containers.searchDepth());
+    }
+}
+
+
+void Storage::setReadMostly(bool enabled){
+    WriteLock lock(shared_mtx);
+    if(enabled){
+        published.rebuild(containers.searchDepth());
+    }else{
+        published.disable();
     }
-    //delete containers;
-    *this = newStorage;
 }
 
 
@@ -160,115 +170,258 @@ ContainerPosition<int> Storage::calculateContainerPosition(int x, int y, int z,
 }
 
 
-std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> Storage::searchUnderContainer(ContainerPosition<int>& position){
-    std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> result;
-    int minX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(position);
-    int maxX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(position);
-    int minY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position);
-    int maxY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position);
-    int minZ = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinZ(position);
-    std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
-    lock.lock();
-    auto current = containers.searchDepth();
-    lock.unlock();
-    for (const auto& container : current) {
-        const ContainerPosition<int>& containerPos = container.first;
-
-        if (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(containerPos) <= maxX && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(containerPos) >= minX &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(containerPos) <= maxY && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(containerPos) >= minY &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxZ(containerPos) < minZ) {
-                result.push_back(container);
-                continue;
+// Контейнеры, крыша которых ровно под дном box
+std::vector<ContainerId> Storage::containersUnder(const BoundingBox<int>& box){
+    std::vector<ContainerId> result;
+    int belowZ = box.min.z - 1;
+    containers.queryBox(BoundingBox<int>(Point<int>(box.min.x, box.min.y, belowZ), Point<int>(box.max.x, box.max.y, belowZ)), [&result, belowZ](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>& item){
+        if(entry.max.z == belowZ){
+            result.push_back(item->getKey());
         }
-    }
-    std::sort(result.begin(), result.end(), comparePosition);
+    });
     return result;
 }
 
 
-std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> Storage::searchUpperContainer(ContainerPosition<int>& position){
-    std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> result;
-    int minX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(position);
-    int maxX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(position);
-    int minY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position);
-    int maxY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position);
-    int maxZ = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxZ(position);
-    std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
-    lock.lock();
-    auto current = containers.searchDepth();
-    lock.unlock();
-    for (const auto& container : current) {
-        const ContainerPosition<int>& containerPos = container.first;
-        
-        if (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(containerPos) <= maxX && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(containerPos) >= minX &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(containerPos) <= maxY && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(containerPos) >= minY &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinZ(containerPos) > maxZ) {
-                result.push_back(container);
-                continue;
+// Предел нагрузки на крышу: у хрупких - допустимое давление, у остальных его нет
+double Storage::loadLimit(const std::shared_ptr<IContainer>& container){
+    auto fragileContainer = std::dynamic_pointer_cast<IFragileContainer>(container);
+    if(fragileContainer == nullptr || (fragileContainer->isType() != "Fragile" && fragileContainer->isType() != "Fragile and Refraged Container")){
+        return SupportGraph::NoLimit;
+    }
+    return fragileContainer->getMaxPressure();
+}
+
+
+double Storage::loadMargin(ContainerId id) const{
+    ReadLock lock(*this);
+    return support.limit(id) - support.load(id);
+}
+
+
+// Хрупкие контейнеры по возрастанию запаса нагрузки
+std::vector<std::pair<ContainerId, double>> Storage::loadMargins() const{
+    std::vector<std::pair<ContainerId, double>> result;
+    ReadLock lock(*this);
+    for(auto& id : support.ids()){
+        if(support.limit(id) != SupportGraph::NoLimit){
+            result.emplace_back(id, support.limit(id) - support.load(id));
         }
     }
-    std::sort(result.begin(), result.end(), comparePositionReverse);
+    std::sort(result.begin(), result.end(), [](const std::pair<ContainerId, double>& a, const std::pair<ContainerId, double>& b){
+        return a.second < b.second || (a.second == b.second && a.first < b.first);
+    });
     return result;
 }
 
 
+// Опора проверяется в трёх точках под дном: у левого и правого края и в центре.
+// Достаточно центра или обоих краёв.
+bool Storage::isSupported(const ContainerPosition<int>& position){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    int midY = box.min.y + (box.max.y - box.min.y) / 2;
+    int z = box.min.z - 1;
+    if(supportedAt(Point<int>(box.min.x + (box.max.x - box.min.x) / 2, midY, z))){
+        return true;
+    }
+    return supportedAt(Point<int>(box.min.x, midY, z)) && supportedAt(Point<int>(box.max.x, midY, z));
+}
 
-double Storage::calculatemass(std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> con, size_t it){
-    double mass = 0;
-    for(size_t i = it + 1; i < con.size(); i++){
-        if((con[i].second)!= nullptr){
-            mass += (*con[i].second).getMass();
-        }
+
+// Точка опирается на контейнер, если его крыша ровно на высоте p.z. Если верх столбца
+// выше p.z (точка под навесом), ответ ищется в дереве.
+bool Storage::supportedAt(const Point<int>& p){
+    int top = heightmap.at(p.x, p.y).top;
+    if(top <= p.z){
+        return top == p.z;
+    }
+    bool supported = false;
+    containers.queryBox(BoundingBox<int>(p, p), [&supported, &p](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>&){
+        supported = entry.max.z == p.z;
+        return !supported;
+    });
+    return supported;
+}
+
+
+// Контейнер падает сверху на самый высокий верх под своим основанием
+ContainerId Storage::dropContainer(std::shared_ptr<IContainer> container, int X, int Y){
+    if(X < 1 || Y < 1){
+        throw std::invalid_argument("Coordinates should be positive");
+    }
+    SharedLock lock(shared_mtx);
+    std::exception_ptr rejection;
+    PlaceStatus status = addInRegion(container, X, Y, 0, true, &rejection);
+    if(rejection){
+        std::rethrow_exception(rejection);
+    }
+    if(status != PlaceStatus::Ok){
+        throw std::invalid_argument(placeStatusMessage(status));
+    }
+    return container->getKey();
+}
+
+
+// Отказ внешней проверки выходит наружу её собственным исключением
+void Storage::addContainer(std::shared_ptr<IContainer> container, int X, int Y, int Z){
+    std::exception_ptr rejection;
+    PlaceStatus status;
+    {
+        SharedLock lock(shared_mtx);
+        status = addInRegion(container, X, Y, Z, false, &rejection);
+    }
+    if(rejection){
+        std::rethrow_exception(rejection);
+    }
+    if(status != PlaceStatus::Ok){
+        throw std::invalid_argument(placeStatusMessage(status));
     }
-    return mass;
 }
 
 
-bool Storage::checkSupport(ContainerPosition<int>& position, std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> con){
-    bool firstSupport = false;
-    bool secondSupport = false;
-    Point<int> first = Point<int>(position.LLDown.x, position.LLDown.y + (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position) - Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position)) / 2, position.LLDown.z - 1);
-    Point<int> second = Point<int>(position.LRDown.x, position.LRDown.y + (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position) - Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position)) / 2, position.LLDown.z - 1);
-    Point<int> middle = Point<int>(position.LLDown.x + (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(position) - Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(position)) / 2, position.LLDown.y + (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position) - Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position)) / 2, position.LLDown.z - 1);
+PlaceStatus Storage::tryAdd(std::shared_ptr<IContainer> container, int X, int Y, int Z){
+    SharedLock lock(shared_mtx);
+    return addInRegion(container, X, Y, Z, false);
+}
+
 
-    for(auto container = con.rbegin(); container != con.rend(); ++container){
-        if(firstSupport == true && secondSupport == true){
-            return true;
+// Вставка под замками полос [X - 1, X + l + 1] (с запасом на касание соседей).
+// Проверка места идёт под shared structure_mtx параллельно с писателями других
+// полос, сама вставка - под эксклюзивной. Груз ложится на всю опору вниз, поэтому
+// если она уходит в чужие полосы, замки берутся заново на всю её ширину.
+// drop - Z не задан, контейнер падает на верх под основанием
+PlaceStatus Storage::addInRegion(std::shared_ptr<IContainer> container, int X, int Y, int Z, bool drop, std::exception_ptr* rejection){
+    if(X < 1 || Y < 1 || (!drop && Z < 1)){
+        return PlaceStatus::InvalidCoordinates;
+    }
+    if(container == nullptr){
+        return PlaceStatus::InvalidContainer;
+    }
+    int minX = X - 1, maxX = X + container->getLength() + 1;
+    while(true){
+        auto guard = regions.lock(minX, maxX);
+        ContainerPosition<int> pos;
+        Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node = nullptr;
+        PlaceStatus status;
+        int needMin = minX, needMax = maxX;
+        {
+            SharedLock read(structure_mtx);
+            if(drop){
+                Z = heightmap.restZ(BoundingBox<int>(Point<int>(X, Y, 0), Point<int>(X + container->getLength(), Y + container->getWidth(), 0)));
+            }
+            status = probePlace(container, X, Y, Z, pos, node, rejection);
+            if(status == PlaceStatus::Ok){
+                widenToSupport(support.closure(containersUnder(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos)), false), needMin, needMax);
+            }
         }
-        if((*container).first.LLUp.z + 1 != position.LLDown.z){
+        if(status != PlaceStatus::Ok){
+            return status;
+        }
+        if(needMin < minX || needMax > maxX){
+            minX = needMin;
+            maxX = needMax;
+            continue;
+        }
+        WriteLock write(structure_mtx);
+        // Вставки в других полосах могли перестроить узлы дерева, узел ищется заново
+        node = containers.SearchInsert(container, pos);
+        if(node == nullptr){
+            return PlaceStatus::NoPlace;
+        }
+        putContainer(container, pos, node);
+        return PlaceStatus::Ok;
+    }
+}
+
+
+// Простое удаление (на контейнере ничего не стоит) под замками его полос и полос опоры.
+// false - контейнера нет или на нём стоят, тогда решает общий путь под эксклюзивной блокировкой
+bool Storage::removeInRegion(ContainerId id){
+    SharedLock lock(shared_mtx);
+    int minX, maxX;
+    {
+        SharedLock read(structure_mtx);
+        auto item = containers.findI(id);
+        if(item.second == nullptr){
             return false;
         }
-        if(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::pointincontainer(first, (*container).first)){
-            firstSupport = true;
+        BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(item.first);
+        minX = box.min.x - 1;
+        maxX = box.max.x + 1;
+    }
+    while(true){
+        auto guard = regions.lock(minX, maxX);
+        int needMin = minX, needMax = maxX;
+        {
+            SharedLock read(structure_mtx);
+            auto item = containers.findI(id);
+            if(item.second == nullptr || !support.above(id).empty()){
+                return false;
+            }
+            BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(item.first);
+            needMin = std::min(needMin, box.min.x - 1);
+            needMax = std::max(needMax, box.max.x + 1);
+            widenToSupport(support.closure(id, false), needMin, needMax);
         }
-        if(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::pointincontainer(second, (*container).first)){
-            secondSupport = true;
+        if(needMin < minX || needMax > maxX){
+            minX = needMin;
+            maxX = needMax;
+            continue;
         }
-        if(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::pointincontainer(middle, (*container).first)){
-            return true;
+        WriteLock write(structure_mtx);
+        return takeContainer(id);
+    }
+}
+
+
+// Расширяет [minX, maxX] до x-габаритов контейнеров ids
+void Storage::widenToSupport(const std::vector<ContainerId>& ids, int& minX, int& maxX){
+    for(auto& id : ids){
+        auto item = containers.findI(id);
+        if(item.second == nullptr){
+            continue;
         }
+        BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(item.first);
+        minX = std::min(minX, box.min.x);
+        maxX = std::max(maxX, box.max.x);
     }
-    return false;
 }
 
-void Storage::addContainer(std::shared_ptr<IContainer> container, int X, int Y, int Z){
+
+PlaceStatus Storage::addLocked(std::shared_ptr<IContainer> container, int X, int Y, int Z){
+    ContainerPosition<int> pos;
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node = nullptr;
+    PlaceStatus status = probePlace(container, X, Y, Z, pos, node);
+    if(status != PlaceStatus::Ok){
+        return status;
+    }
+    putContainer(container, pos, node);
+    return PlaceStatus::Ok;
+}
+
+
+// Проверка места без изменения склада, поэтому её можно звать из нескольких
+// потоков сразу, пока склад никто не меняет
+PlaceStatus Storage::probePlace(std::shared_ptr<IContainer> container, int X, int Y, int Z, ContainerPosition<int>& pos, Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node*& node, std::exception_ptr* rejection){
     if(X < 1 || Y < 1 || Z < 1){
-        throw std::invalid_argument("Coordinates should be positive");
+        return PlaceStatus::InvalidCoordinates;
     }
-    ContainerPosition<int> pos = calculateContainerPosition(X, Y, Z, container->getLength(), container->getWidth(), container->getHeight());
-    auto cache = containers.SearchInsert(container, pos);
-    if(cache == nullptr){
-        throw std::invalid_argument("Valid place for container doesn t exist");
+    if(container == nullptr){
+        return PlaceStatus::InvalidContainer;
     }
-    checker.applyChecks(*this ,container, pos);
-    (containers).insert(container, pos, cache);
-    container->setId(X, Y, Z);
+    pos = calculateContainerPosition(X, Y, Z, container->getLength(), container->getWidth(), container->getHeight());
+    node = containers.SearchInsert(container, pos);
+    if(node == nullptr){
+        return PlaceStatus::NoPlace;
+    }
+    return checker.check(*this, container, pos, rejection);
 }
 
 
 
 //Информация о складе
 std::string Storage::getInfoAboutStorage() const{
+    ReadLock lock(*this);
     std::string result = "Length: " + std::to_string(length) + ", Width: " + std::to_string(width) + ", Height: "
     + std::to_string(height) + ", Temperature: " + std::to_string(temperature);
     return result;
@@ -277,58 +430,47 @@ std::string Storage::getInfoAboutStorage() const{
 
 
 bool Storage::isNoTop(const ContainerPosition<int>& position){
-    int minX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(position);
-    int maxX = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(position);
-    int minY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(position);
-    int maxY = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(position);
-    int maxZ = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxZ(position);
-    std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
-    lock.lock();
-    auto copy = containers.searchDepth();
-    lock.unlock();
-    
-    for(auto i : copy){
-        const ContainerPosition<int>& containerPos = i.first;
-        if (Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinX(containerPos) <= maxX && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxX(containerPos) >= minX &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinY(containerPos) <= maxY && Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMaxY(containerPos) >= minY &&
-            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::getMinZ(containerPos) == maxZ + 1) {
-                return false;
-        }
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    // Выше крыши ничего нет ни в одном столбце - сверху точно пусто
+    if(heightmap.maxTop(box) <= box.max.z){
+        return true;
     }
-
-    return true;
+    int topZ = box.max.z + 1;
+    BoundingBox<int> layer(Point<int>(box.min.x, box.min.y, topZ), Point<int>(box.max.x, box.max.y, topZ));
+    bool noTop = true;
+    containers.queryBox(layer, [&noTop, topZ](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>&){
+        if(entry.min.z == topZ){
+            noTop = false;
+        }
+        return noTop;
+    });
+    return noTop;
 }
 
 
 //перемещения
 void Storage::moveContainer(std::string id, int X, int Y, int Z){
+    moveContainer(ContainerId::parse(id), X, Y, Z);
+}
+
+
+void Storage::moveContainer(ContainerId id, int X, int Y, int Z){
     if(X < 1 || Y < 1 || Z < 1){
         throw std::invalid_argument("Invalid coordinate");
     }
-    auto cache = containers.search(id);
-    if(cache == nullptr){
+    WriteLock lock(shared_mtx);
+    auto item = containers.findI(id);
+    if(item.second == nullptr){
         throw std::invalid_argument("Container does not exist");
     }
-    std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> item;
-    for(auto& i : cache->con){//con
-        if(i.second->getId() == id){
-            item.first = i.first;
-            item.second = i.second;
-            cache->con.erase(std::remove(cache->con.begin(), cache->con.end(), i), cache->con.end());
-            break;
-        }
-    }
     if(!isNoTop(item.first)){
-        containers.insert(item.second, item.first, cache);
-        item.second->setId(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z); 
         throw std::invalid_argument("Not a top containerMove");
     }
-    try{
-        addContainer(item.second, X, Y, Z);
-    }catch(std::exception &e){
-        std::cerr << "Error: " << e.what() << std::endl;
-        containers.insert(item.second, item.first, cache);
-        item.second->setId(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z);
+    takeContainer(id);
+    PlaceStatus status = addLocked(item.second, X, Y, Z);
+    if(status != PlaceStatus::Ok){
+        std::cerr << "Error: " << placeStatusMessage(status) << std::endl;
+        restoreContainer(item.first, item.second);
         throw std::invalid_argument("Can't move container "); 
     }
 }
@@ -336,197 +478,662 @@ void Storage::moveContainer(std::string id, int X, int Y, int Z){
 
 //Повороты 
 void Storage::rotateContainer(std::string id, int method) {
-    auto cache = containers.search(id);
-    if(cache == nullptr){
-        throw std::invalid_argument("Container does not exist1" + id);
-    }
-    std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> item;
-    for(auto& i : cache->con){
-        if(i.second->getId() == id){
-            item.first = i.first;
-            item.second = i.second;
-            cache->con.erase(std::remove(cache->con.begin(), cache->con.end(), i), cache->con.end());
-            break;
-        }
+    rotateContainer(ContainerId::parse(id), method);
+}
+
+
+void Storage::rotateContainer(ContainerId id, int method) {
+    WriteLock lock(shared_mtx);
+    auto item = containers.findI(id);
+    if(item.second == nullptr){
+        throw std::invalid_argument("Container does not exist1" + id.toString());
     }
     std::shared_ptr<IContainer> container = item.second;
     if(container->isType() == "Fragile" || container->isType() == "Fragile and Refraged Container"){
-        containers.insert(item.second, item.first, cache);
-        item.second->setId(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z);
         throw std::invalid_argument("Fragile container cannot be rotated");
     }
     ContainerPosition<int> pos = item.first;
     if(!isNoTop(pos)){
-        containers.insert(item.second, item.first, cache);
-        item.second->setId(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z);
         throw std::invalid_argument("No top container");
     }
     int X = pos.LLDown.x;
     int Y = pos.LLDown.y;
     int Z = pos.LLDown.z;
+    takeContainer(id);
     std::shared_ptr<IContainer> newContainer = container->Clone(0, method);
-    try{
-        addContainer(newContainer, X, Y, Z);
-        item.second.reset();
-    }catch(std::exception &e){
-        std::cerr << "Error: " << e.what() << std::endl;
-        containers.insert(item.second, item.first, cache);
-        item.second->setId(item.first.LLDown.x, item.first.LLDown.y, item.first.LLDown.z);
+    PlaceStatus status = addLocked(newContainer, X, Y, Z);
+    if(status != PlaceStatus::Ok){
+        std::cerr << "Error: " << placeStatusMessage(status) << std::endl;
+        restoreContainer(item.first, item.second);
         newContainer.reset();
         throw std::invalid_argument("Can't rotate container ");
     }
+    item.second.reset();
+}
+
+
+std::string Storage::addContainer(std::shared_ptr<IContainer> container){
+    return placeContainer(container).toString();
+}
+
+
+// Перебираются только точки-кандидаты из freeSpace в порядке (y, x, z),
+// а не все целые координаты склада
+ContainerId Storage::placeContainer(std::shared_ptr<IContainer> container){
+    ContainerId id;
+    tryPlace(container, id);
+    return id;
+}
+
+
+std::string Storage::addContainer(std::shared_ptr<IContainer> container, PlacementStrategy strategy){
+    return placeContainer(container, strategy).toString();
+}
+
+
+ContainerId Storage::placeContainer(std::shared_ptr<IContainer> container, PlacementStrategy strategy){
+    ContainerId id;
+    tryPlace(container, id, strategy);
+    return id;
+}
+
+
+PlaceStatus Storage::tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, std::stop_token token){
+    return tryPlace(container, id, getPlacementStrategy(), token);
+}
+
+
+PlaceStatus Storage::tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, std::stop_token token){
+    return placeShared(container, id, strategy, placementScore(strategy), token);
+}
+
+
+// Возвращает причину отказа последнего кандидата, если ни один не подошёл
+PlaceStatus Storage::placeLocked(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, std::stop_token token){
+    bool noRoom;
+    return searchPlace(container, id, strategy, placementScore(strategy), token, noRoom);
+}
+
+
+// Оцениваются все подходящие кандидаты, выбирается кандидат с наименьшей оценкой
+PlaceStatus Storage::tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, const PlacementScore& score, std::stop_token token){
+    return placeShared(container, id, PlacementStrategy::FirstFit, score, token);
+}
+
+
+// Размещение без эксклюзивной блокировки склада: кандидат выбирается под shared
+// structure_mtx, его бокс арендуется, и контейнер вставляется через addInRegion
+// под замками полос. Если место перехватила явная вставка, поиск повторяется
+// по новому состоянию склада. Если подходящее место занято чужой арендой, поиск
+// ждёт её освобождения, отпустив склад. Всего попыток не больше PlaceAttempts.
+PlaceStatus Storage::placeShared(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token){
+    id = ContainerId();
+    if(container == nullptr){
+        return PlaceStatus::InvalidContainer;
+    }
+    SharedLock lock(shared_mtx);
+    PlaceStatus status = PlaceStatus::NoPlace;
+    // Чужая аренда кончится вместе с её вставкой; склад на время ожидания отпускается
+    auto waitLease = [this, &lock, &token](uint64_t seen){
+        lock.unlock();
+        leases.waitRelease(seen, token);
+        lock.lock();
+    };
+    for(int attempt = 0; attempt < PlaceAttempts && !token.stop_requested(); ++attempt){
+        uint64_t seen = leases.releases();
+        std::vector<Point<int>> candidates;
+        std::vector<PlaceStatus> statuses;
+        std::atomic<bool> leaseBlocked(false);
+        size_t best;
+        {
+            SharedLock read(structure_mtx);
+            candidates = freeSpace.candidates();
+            best = selectPlace(container, candidates, statuses, strategy, score, token, leaseBlocked);
+        }
+        if(best == candidates.size()){
+            if(!token.stop_requested() && leaseBlocked){
+                waitLease(seen);
+                continue;
+            }
+            return placeBest(container, candidates, statuses, best, token, id);
+        }
+        ContainerPosition<int> pos = calculateContainerPosition(candidates[best].x, candidates[best].y, candidates[best].z, container->getLength(), container->getWidth(), container->getHeight());
+        PlacementLeases::Lease lease = leases.acquire(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos));
+        if(!lease){
+            waitLease(seen);
+            continue;
+        }
+        status = addInRegion(container, candidates[best].x, candidates[best].y, candidates[best].z, false);
+        if(status == PlaceStatus::Ok){
+            id = container->getKey();
+            return status;
+        }
+    }
+    return token.stop_requested() ? PlaceStatus::Cancelled : status;
+}
+
+
+// Порядок обхода кандидатов по стратегии и индекс выбранного или candidates.size()
+// leaseBlocked - подходящий кандидат отброшен только из-за чужой аренды
+size_t Storage::selectPlace(std::shared_ptr<IContainer> container, std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token, std::atomic<bool>& leaseBlocked){
+    if(!score && strategy == PlacementStrategy::RandomRestart){
+        std::lock_guard<std::mutex> lock(random_mtx);
+        std::shuffle(candidates.begin(), candidates.end(), random);
+    }
+    statuses.assign(candidates.size(), PlaceStatus::NoPlace);
+    return score ? scorePlace(container, candidates, statuses, score, token, leaseBlocked) : findPlace(container, candidates, statuses, token, leaseBlocked);
+}
+
+
+// Общая часть tryPlace и addContainers. Без score берётся первый подходящий кандидат.
+// noRoom - контейнер не влез ни в одну точку по габаритам, до проверок дело не дошло.
+PlaceStatus Storage::searchPlace(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token, bool& noRoom){
+    id = ContainerId();
+    noRoom = false;
+    if(container == nullptr){
+        return PlaceStatus::InvalidContainer;
+    }
+    std::vector<Point<int>> candidates = freeSpace.candidates();
+    std::vector<PlaceStatus> statuses;
+    // Под эксклюзивной блокировкой чужих аренд нет
+    std::atomic<bool> leaseBlocked(false);
+    size_t best = selectPlace(container, candidates, statuses, strategy, score, token, leaseBlocked);
+    noRoom = best == candidates.size() && !token.stop_requested() &&
+             std::all_of(statuses.begin(), statuses.end(), [](PlaceStatus status){ return status == PlaceStatus::NoPlace; });
+    return placeBest(container, candidates, statuses, best, token, id);
+}
+
+
+// Пока в партии ничего не добавилось, склад не меняется, и контейнер не меньше
+// уже не влезшего ни по одному измерению тоже не влезет - его поиск пропускается.
+// Температура от места не зависит и проверяется до поиска.
+std::vector<BatchResult> Storage::addContainers(std::span<const std::shared_ptr<IContainer>> batch, BatchPolicy policy){
+    std::vector<BatchResult> results(batch.size());
+    WriteLock lock(shared_mtx);
+    PlacementScore score = placementScore(policy.strategy);
+    std::vector<std::shared_ptr<IContainer>> noRoom;
+    for(size_t index : batchOrder(batch, policy.order)){
+        BatchResult& result = results[index];
+        result.container = batch[index];
+        if(result.container == nullptr){
+            result.status = PlaceStatus::InvalidContainer;
+            continue;
+        }
+        result.status = checkTemperature(*this, result.container, ContainerPosition<int>());
+        if(result.status != PlaceStatus::Ok){
+            continue;
+        }
+        bool skip = std::any_of(noRoom.begin(), noRoom.end(), [&result](const std::shared_ptr<IContainer>& failed){
+            return result.container->getLength() >= failed->getLength() && result.container->getWidth() >= failed->getWidth() && result.container->getHeight() >= failed->getHeight();
+        });
+        if(skip){
+            result.status = PlaceStatus::NoPlace;
+            continue;
+        }
+        bool failed;
+        result.status = searchPlace(result.container, result.id, policy.strategy, score, std::stop_token(), failed);
+        if(result.status == PlaceStatus::Ok){
+            noRoom.clear();
+        }else if(failed){
+            noRoom.push_back(result.container);
+        }
+    }
+    return results;
+}
+
+
+std::vector<size_t> Storage::batchOrder(std::span<const std::shared_ptr<IContainer>> batch, BatchOrder order){
+    std::vector<size_t> indexes(batch.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    if(order == BatchOrder::AsGiven){
+        return indexes;
+    }
+    auto volume = [](const std::shared_ptr<IContainer>& container){
+        return container == nullptr ? 0.0 : static_cast<double>(container->getLength()) * container->getWidth() * container->getHeight();
+    };
+    auto group = [order](const std::shared_ptr<IContainer>& container){
+        if(order == BatchOrder::Fragility){
+            return std::dynamic_pointer_cast<IFragileContainer>(container) != nullptr ? 1 : 0;
+        }
+        if(order == BatchOrder::Refrigeration){
+            return std::dynamic_pointer_cast<IRefragedContainer>(container) != nullptr ? 0 : 1;
+        }
+        return 0;
+    };
+    std::stable_sort(indexes.begin(), indexes.end(), [&](size_t a, size_t b){
+        int groupA = group(batch[a]);
+        int groupB = group(batch[b]);
+        if(groupA != groupB){
+            return groupA < groupB;
+        }
+        return volume(batch[a]) > volume(batch[b]);
+    });
+    return indexes;
 }
 
 
-void Storage::multitread(std::shared_ptr<IContainer> container, int X, int Y, int Z){
-    std::unique_lock<std::mutex> ul(mtx, std::defer_lock);
-    ContainerPosition<int> pos = calculateContainerPosition(X, Y, Z, container->getLength(), container->getWidth(), container->getHeight());
-    ul.lock();
-    auto cache = containers.SearchInsert(container, pos); //Иначе будет data race shared_mutex юзать нет смысла много записи 
-    ul.unlock();
-    if(cache == nullptr){
-        throw std::invalid_argument("Valid place for container doesn t exist");
+PlaceStatus Storage::placeBest(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, const std::vector<PlaceStatus>& statuses, size_t best, std::stop_token token, ContainerId& id){
+    if(best == candidates.size()){
+        if(token.stop_requested()){
+            return PlaceStatus::Cancelled;
+        }
+        return statuses.empty() ? PlaceStatus::NoPlace : statuses.back();
     }
-    checker.applyChecks(*this, container, pos);
-    ul.lock();
-    if(!containerAdded.load()){
-        containerAdded.store(true);
-        containers.insert(container, pos, cache);
-        container->setId(X, Y, Z);
+    PlaceStatus status = addLocked(container, candidates[best].x, candidates[best].y, candidates[best].z);
+    if(status == PlaceStatus::Ok){
+        id = container->getKey();
+    }
+    return status;
+}
+
+
+// Кандидаты режутся на порции по PlaceChunk, потоки пула разбирают их по общему
+// счётчику: освободившийся поток сразу берёт следующую порцию. Порции выдаются
+// по возрастанию; body возвращает false, когда этому потоку больше нечего делать.
+void Storage::runChunks(size_t count, std::stop_token token, const std::function<bool(size_t, size_t)>& body){
+    size_t chunks = (count + PlaceChunk - 1) / PlaceChunk;
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&](){
+        while(!token.stop_requested()){
+            size_t chunk = nextChunk.fetch_add(1);
+            if(chunk >= chunks || !body(chunk * PlaceChunk, std::min(chunk * PlaceChunk + PlaceChunk, count))){
+                return;
+            }
+        }
+    };
+    size_t workers = pool ? std::min(pool->size(), chunks) : 1;
+    if(workers <= 1){
+        worker();
         return;
     }
-    ul.unlock();
-    if(containerAdded.load()){
-        throw std::invalid_argument("Container already added");
-    }
-}
-
-bool Storage::addContainerR(std::shared_ptr<IContainer> container, int yStart, int yEnd){
-    std::unique_lock<std::mutex> ul(mtx, std::defer_lock);
-    for(int y = yStart; y <= yEnd; y++){
-        for(int x = 1; x <= length; x++){
-            for(int z = 1; z <= height; z++){
-                try{
-                    if(containerAdded.load()){
-                        return true;
-                    }
-                    multitread(container, x, y, z);
-                    return true;
-                }catch(std::invalid_argument &e){
-                }
+    // Ждущий выполняет только порции своей группы: он держит блокировки склада,
+    // и чужая задача, пишущая в этот склад, сцепилась бы с ним
+    std::vector<std::future<void>> tasks;
+    ThreadPool::TaskGroup group(*pool);
+    for(size_t i = 1; i < workers; ++i){
+        tasks.push_back(group.submit(worker));
+    }
+    worker();
+    group.wait();
+    for(auto& task : tasks){
+        task.get();
+    }
+}
+
+
+// Индекс первого подходящего кандидата или candidates.size(). Порция, начинающаяся
+// после уже найденного кандидата, не проверяется, поэтому ответ не зависит
+// от числа потоков и совпадает с последовательным перебором.
+size_t Storage::findPlace(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, std::stop_token token, std::atomic<bool>& leaseBlocked){
+    std::atomic<size_t> best(candidates.size());
+    runChunks(candidates.size(), token, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            if(i >= best.load() || token.stop_requested()){
+                return false;
+            }
+            ContainerPosition<int> pos;
+            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node = nullptr;
+            statuses[i] = probePlace(container, candidates[i].x, candidates[i].y, candidates[i].z, pos, node);
+            if(statuses[i] == PlaceStatus::Ok && leases.leased(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos))){
+                statuses[i] = PlaceStatus::NoPlace;
+                leaseBlocked = true;
+            }
+            if(statuses[i] == PlaceStatus::Ok){
+                size_t current = best.load();
+                while(i < current && !best.compare_exchange_weak(current, i));
+                return false;
             }
         }
+        return true;
+    });
+    return best.load();
+}
+
+
+// Индекс подходящего кандидата с наименьшей оценкой, при равных - более раннего
+size_t Storage::scorePlace(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, const PlacementScore& score, std::stop_token token, std::atomic<bool>& leaseBlocked){
+    std::vector<double> scores(candidates.size());
+    runChunks(candidates.size(), token, [&](size_t begin, size_t end){
+        for(size_t i = begin; i < end; ++i){
+            if(token.stop_requested()){
+                return false;
+            }
+            ContainerPosition<int> pos;
+            Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node = nullptr;
+            statuses[i] = probePlace(container, candidates[i].x, candidates[i].y, candidates[i].z, pos, node);
+            if(statuses[i] == PlaceStatus::Ok && leases.leased(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos))){
+                statuses[i] = PlaceStatus::NoPlace;
+                leaseBlocked = true;
+            }
+            if(statuses[i] == PlaceStatus::Ok){
+                scores[i] = score(*this, container, pos);
+            }
+        }
+        return true;
+    });
+    size_t best = candidates.size();
+    if(token.stop_requested()){
+        return best;
     }
-    return false;
+    for(size_t i = 0; i < candidates.size(); ++i){
+        if(statuses[i] == PlaceStatus::Ok && (best == candidates.size() || scores[i] < scores[best])){
+            best = i;
+        }
+    }
+    return best;
 }
 
-std::string Storage::addContainer(std::shared_ptr<IContainer> container){
-    std::vector<std::thread>  threads;
-    for (int y = 1; y <= width; y += 20) {
-        int yEnd = std::min(y + 20, width);
-        threads.emplace_back(&Storage::addContainerR, this, container, y, yEnd);
+
+PlacementScore Storage::placementScore(PlacementStrategy strategy){
+    switch(strategy){
+        case PlacementStrategy::BottomLeftBack:
+            return scoreBottomLeftBack;
+        case PlacementStrategy::BestFit:
+            return scoreBestFit;
+        case PlacementStrategy::LowestHeight:
+            return scoreLowestHeight;
+        default:
+            return PlacementScore();
+    }
+}
+
+
+double Storage::scoreBottomLeftBack(Storage& storage, std::shared_ptr<IContainer>, const ContainerPosition<int>& pos){
+    double cells = static_cast<double>(storage.length + 1) * (storage.width + 1);
+    return pos.LLDown.z * cells + pos.LLDown.x * static_cast<double>(storage.width + 1) + pos.LLDown.y;
+}
+
+
+double Storage::scoreBestFit(Storage& storage, std::shared_ptr<IContainer>, const ContainerPosition<int>& pos){
+    return -static_cast<double>(storage.contactArea(pos));
+}
+
+
+double Storage::scoreLowestHeight(Storage&, std::shared_ptr<IContainer>, const ContainerPosition<int>& pos){
+    return Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos).max.z;
+}
+
+
+// Площадь касания в клетках сетки: опора снизу, стены склада и соседи по бокам
+size_t Storage::contactArea(const ContainerPosition<int>& position){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    size_t sizeX = box.max.x - box.min.x + 1;
+    size_t sizeY = box.max.y - box.min.y + 1;
+    size_t sizeZ = box.max.z - box.min.z + 1;
+    size_t area = box.min.z == 1 ? sizeX * sizeY : heightmap.countTop(box, box.min.z - 1);
+    if(box.min.x == 1){
+        area += sizeY * sizeZ;
+    }
+    if(box.max.x == length - 1){
+        area += sizeY * sizeZ;
+    }
+    if(box.min.y == 1){
+        area += sizeX * sizeZ;
     }
-    for (auto& t : threads) {
-        t.join();
+    if(box.max.y == width - 1){
+        area += sizeX * sizeZ;
     }
-    if (!containerAdded.load()) {
-        return "_";
-    } else {
-        containerAdded.store(false);
-        return container->getId();
+    auto overlap = [](int min1, int max1, int min2, int max2) -> size_t{
+        int size = std::min(max1, max2) - std::max(min1, min2) + 1;
+        return size > 0 ? size : 0;
+    };
+    BoundingBox<int> around(Point<int>(box.min.x - 1, box.min.y - 1, box.min.z), Point<int>(box.max.x + 1, box.max.y + 1, box.max.z));
+    containers.queryBox(around, [&](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>&){
+        size_t sideZ = overlap(box.min.z, box.max.z, entry.min.z, entry.max.z);
+        if(entry.max.x + 1 == box.min.x || entry.min.x == box.max.x + 1){
+            area += overlap(box.min.y, box.max.y, entry.min.y, entry.max.y) * sideZ;
+        }else if(entry.max.y + 1 == box.min.y || entry.min.y == box.max.y + 1){
+            area += overlap(box.min.x, box.max.x, entry.min.x, entry.max.x) * sideZ;
+        }
+    });
+    return area;
+}
+
+
+void Storage::putContainer(std::shared_ptr<IContainer> container, const ContainerPosition<int>& pos, Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node){
+    containers.insert(container, pos, node);
+    container->setId(pos.LLDown.x, pos.LLDown.y, pos.LLDown.z);
+    linkSupport(pos, container, true);
+    ContainerId key = container->getKey();
+    if(support.above(key).empty()){
+        support.carry(key, container->getMass());
+    }else{
+        support.recount(support.closure(std::vector<ContainerId>{key}, false));
+    }
+    heightmap.raise(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos), container->getKey());
+    occupyFreeSpace(pos);
+    if(versionsBuilt){
+        versions.insert(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos), container);
+    }
+    if(published.enabled()){
+        published.put(key, pos, container);
     }
 }
 
 
+// Возвращает снятый takeContainer контейнер на прежнее место без проверок
+void Storage::restoreContainer(const ContainerPosition<int>& pos, std::shared_ptr<IContainer> container){
+    auto node = containers.SearchInsert(container, pos);
+    if(node == nullptr){
+        throw std::logic_error("Place of container " + container->getId() + " is taken");
+    }
+    putContainer(container, pos, node);
+}
+
+
+bool Storage::takeContainer(ContainerId id){
+    auto item = containers.findI(id);
+    if(item.second == nullptr){
+        return false;
+    }
+    containers.remove(id);
+    std::vector<ContainerId> affected;
+    if(support.above(id).empty()){
+        support.carry(id, -item.second->getMass());
+    }else{
+        affected = support.closure(id, false);
+    }
+    support.remove(id);
+    support.recount(affected);
+    lowerHeightmap(item.first);
+    releaseFreeSpace(item.first);
+    if(versionsBuilt){
+        versions.remove(id);
+    }
+    if(published.enabled()){
+        published.erase(id);
+    }
+    return true;
+}
+
+
+//Свободное место
+
+// Новые кандидаты - углы у правой, дальней и верхней граней контейнера
+void Storage::occupyFreeSpace(const ContainerPosition<int>& position){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    freeSpace.eraseInside(box);
+    addFreePoint(Point<int>(box.max.x + 1, box.min.y, box.min.z));
+    addFreePoint(Point<int>(box.min.x, box.max.y + 1, box.min.z));
+    addFreePoint(Point<int>(box.min.x, box.min.y, box.max.z + 1));
+}
+
+
+// Угол убранного контейнера снова свободен, а кандидаты на его крыше больше ни на что не опираются
+void Storage::releaseFreeSpace(const ContainerPosition<int>& position){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    freeSpace.eraseInside(BoundingBox<int>(Point<int>(box.min.x, box.min.y, box.max.z + 1), Point<int>(box.max.x, box.max.y, box.max.z + 1)));
+    addFreePoint(box.min);
+}
+
+
+// Висящая точка дополнительно проецируется вниз, на пол или крышу контейнера под ней
+void Storage::addFreePoint(const Point<int>& p){
+    if(p.z > 1){
+        int z = restZ(p.x, p.y, p.z);
+        if(z != p.z && !containers.collides(BoundingBox<int>(Point<int>(p.x, p.y, z), Point<int>(p.x, p.y, z)))){
+            freeSpace.add(Point<int>(p.x, p.y, z));
+        }
+    }
+    if(!containers.collides(BoundingBox<int>(p, p))){
+        freeSpace.add(p);
+    }
+}
+
+
+// Высота, на которую опустится точка (x, y, z): крыша ближайшего контейнера под ней или пол
+int Storage::restZ(int x, int y, int z){
+    int top = heightmap.at(x, y).top;
+    if(top < z){
+        return top + 1;
+    }
+    int rest = 1;
+    BoundingBox<int> column(Point<int>(x, y, std::numeric_limits<int>::lowest()), Point<int>(x, y, z - 1));
+    containers.queryBox(column, [&rest, z](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>&){
+        if(entry.max.z < z){
+            rest = std::max(rest, entry.max.z + 1);
+        }
+    });
+    return rest;
+}
+
+
+//Карта высот
+
+// После удаления верх клеток под контейнером пересчитывается по дереву
+void Storage::lowerHeightmap(const ContainerPosition<int>& position){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    heightmap.clear(box);
+    BoundingBox<int> column(Point<int>(box.min.x, box.min.y, std::numeric_limits<int>::lowest()), Point<int>(box.max.x, box.max.y, std::numeric_limits<int>::max()));
+    containers.queryBox(column, [this](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>& item){
+        heightmap.raise(entry, item->getKey());
+    });
+}
+
+
+void Storage::rebuildHeightmap(){
+    heightmap = Heightmap(length, width);
+    containers.forEachEntry([this](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>& item){
+        heightmap.raise(entry, item->getKey());
+    });
+}
+
+
+// Рёбра к контейнерам, на которых стоит новый, и, если linkAbove, к стоящим на нём.
+// Нагрузку не трогает, её пересчитывают вызывающие.
+void Storage::linkSupport(const ContainerPosition<int>& position, const std::shared_ptr<IContainer>& container, bool linkAbove){
+    BoundingBox<int> box = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(position);
+    ContainerId id = container->getKey();
+    support.add(id, container->getMass(), loadLimit(container));
+    for(auto& below : containersUnder(box)){
+        support.link(below, id);
+    }
+    if(!linkAbove){
+        return;
+    }
+    int aboveZ = box.max.z + 1;
+    containers.queryBox(BoundingBox<int>(Point<int>(box.min.x, box.min.y, aboveZ), Point<int>(box.max.x, box.max.y, aboveZ)), [this, id, aboveZ](const BoundingBox<int>& entry, const std::shared_ptr<IContainer>& item){
+        if(entry.min.z == aboveZ){
+            support.link(id, item->getKey());
+        }
+    });
+}
+
+
+// Каждое ребро заводится один раз - со стороны верхнего контейнера
+void Storage::rebuildSupportGraph(){
+    support.clear();
+    containers.forEachEntry([this](const BoundingBox<int>& box, const std::shared_ptr<IContainer>& item){
+        linkSupport(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toPosition(box), item, false);
+    });
+    support.recount(support.ids());
+}
+
+
+void Storage::rebuildFreeSpace(){
+    freeSpace = FreeSpace(length, width, height);
+    freeSpace.clear();
+    addFreePoint(Point<int>(1, 1, 1));
+    containers.forEachEntry([this](const BoundingBox<int>& box, const std::shared_ptr<IContainer>&){
+        occupyFreeSpace(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toPosition(box));
+    });
+}
+
+
 void Storage::removeContainer(std::string id){
-    auto cache2 = containers.search(id);
+    removeContainer(ContainerId::parse(id));
+}
+
+
+void Storage::removeContainer(ContainerId id){
+    if(removeInRegion(id)){
+        return;
+    }
+    WriteLock lock(shared_mtx);
     auto cache = containers.findI(id);
-    if(cache2 == nullptr){
-        throw std::invalid_argument("No container on storage with id " + id);
+    if(cache.second == nullptr){
+        throw std::invalid_argument("No container on storage with id " + id.toString());
     }
-    std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> con = searchUpperContainer(cache.first);
-    if(con.empty()){
+    if(support.above(id).empty()){
         //Простой случай, если на верху нет 
-        containers.remove(id);
+        takeContainer(id);
     }else{
-        //Сложный случай, если на верху есть контейнеры
-        std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> copy_delete = std::make_pair(cache.first, cache.second->Clone());
-        std::list<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> con_copy;
-        std::list<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> lst;
-        lst.insert(lst.end(), con.begin(), con.end());
-        lst = searchAllContainersUpper(lst);
-        
-        //Удаляем контейнеры, делаем их копии, т.к. они в разных узлах дерева
-
-
-        for(auto& i : lst){
-            if(i.second != nullptr){
-                con_copy.insert(con_copy.begin(), std::make_pair(i.first, i.second->Clone()));
-                bool flag = containers.remove(i.second->getId());
+        //Сложный случай, если на верху есть контейнеры: снимаем всё, что прямо
+        //или через других стоит на удаляемом, и раскидываем по новым местам.
+        //При неудаче журнал транзакции возвращает все контейнеры на старые места без проверок
+        std::vector<std::shared_ptr<IContainer>> lifted;
+        for(auto& above : support.closure(id, true)){
+            auto item = containers.findI(above);
+            if(item.second == nullptr){
+                throw std::logic_error("Support graph refers to missing container " + above.toString());
             }
+            lifted.push_back(item.second);
         }
-
-        containers.remove(id);
-        //Пытаемся раскидать контейнеры по новым позициям
-
-        std::vector<std::string> newPlacement;
-        for(auto& container : con_copy){
-            auto last = container.second->Clone();
-            std::string newId = addContainer(last);
-
-            //Возврат, если не получилось раскидать контейнеры
-            if(newId == "_"){
-                last.reset();
-                for(auto& return_containerId : newPlacement){
-                    containers.remove(return_containerId);
-                }
-                    addContainer(copy_delete.second, copy_delete.first.LLDown.x, copy_delete.first.LLDown.y, copy_delete.first.LLDown.z);
-                    for(auto& ret : con_copy){
-                        addContainer(ret.second, ret.first.LLDown.x, ret.first.LLDown.y, ret.first.LLDown.z);
-                    }
-                throw std::invalid_argument("No space found to move container with id " + id);
-            }
-            //Страховка         
-            
-            else{
-                newPlacement.push_back(newId);
-            }
-
-
+        StorageTransaction transaction(*this, std::defer_lock);
+        for(auto& container : lifted){
+            transaction.take(container->getKey());
         }
-        //Удаляем копии контейнеров
-        for(auto& i : con_copy){
-            i.second.reset();
+        transaction.take(id);
+        for(auto it = lifted.rbegin(); it != lifted.rend(); ++it){
+            if(!transaction.place(*it).valid()){
+                transaction.rollback();
+                throw std::invalid_argument("No space found to move container with id " + id.toString());
+            }
         }
-        copy_delete.second.reset();
+        transaction.commit();
     }
 }
 
 
 std::string Storage::getInfo() const{
-    std::string result;
-    auto container = containers.searchDepth();
-    if(container.empty()){
-        return "No containers on storage.";
+    std::ostringstream result;
+    getInfo(result);
+    return result.str();
+}
+
+
+void Storage::getInfo(std::ostream& output) const{
+    ReadLock lock(*this);
+    if(containers.size() == 0){
+        output << "No containers on storage.";
+        return;
     }
-    for(auto& con : container){
-        if(con.second != nullptr){
-            result += con.second->getId() + " " + std::to_string(con.second->getLength()) + " x " +
-        std::to_string(con.second->getWidth()) + " x " + std::to_string(con.second->getHeight()) + " " +
-        con.second->isType() + "\n"; 
+    containers.forEachEntry([&output](const BoundingBox<int>&, const std::shared_ptr<IContainer>& con){
+        if(con != nullptr){
+            output << con->getId() << " " << con->getLength() << " x " << con->getWidth() << " x " << con->getHeight() << " " << con->isType() << "\n";
         }
-    }
-    return result;
+    });
 }
 
 
-void Storage::howContai(std::shared_ptr<IContainer> container, std::vector<size_t>& result, size_t method){
+void Storage::howContai(const Storage& source, std::shared_ptr<IContainer> container, std::vector<size_t>& result, size_t method){
     size_t count = 0;
     std::shared_ptr<IContainer> currentContainer = container->Clone(0, method);
-    Storage st(*this);
+    // Копия только добавляет новые контейнеры, поэтому стоящие делит со снимком
+    Storage st(source, false);
     while (true) 
     {
-        if (st.addContainer(currentContainer) != "_") {
+        if (st.placeContainer(currentContainer).valid()) {
             result[method]++;
             currentContainer = currentContainer->Clone(result[method], method);
             std::cout << "Added " << method << " " << result[method] << std::endl;
@@ -539,20 +1146,59 @@ void Storage::howContai(std::shared_ptr<IContainer> container, std::vector<size_
 }
 
 
+ StorageSnapshot Storage::snapshot() const{
+    ReadLock lock(*this);
+    // Писатели сюда не попадают, пока держится ReadLock; мьютекс - от второго снимка
+    std::lock_guard<std::mutex> build(versions_mtx);
+    if(!versionsBuilt){
+        std::vector<StorageSnapshot::Tree::Entry> entries;
+        entries.reserve(containers.size());
+        containers.forEachEntry([&entries](const BoundingBox<int>& box, const std::shared_ptr<IContainer>& item){
+            entries.push_back(StorageSnapshot::Tree::Entry{box, item});
+        });
+        BoundingBox<int> bound(Point<int>(-1, -1, -1), Point<int>(length, width, height));
+        versions = StorageSnapshot::Tree(bound, splitPolicy, std::move(entries));
+        versionsBuilt = true;
+    }
+    return StorageSnapshot(versions, length, width, height);
+}
+
+
+ // Задачи работают на снимке, поэтому склад не остаётся заблокированным, пока они идут
  size_t Storage::howContainer(std::shared_ptr<IContainer> container){
     std::vector<size_t> result(6, 0);
-    std::vector<std::thread> threads;
+    std::vector<std::future<void>> tasks;
+    Storage snapshot(*this);
+    ThreadPool::TaskGroup group(*pool);
     for (size_t i = 0; i < 6; ++i) {
-        threads.emplace_back(&Storage::howContai, this, container, std::ref(result), i);
+        tasks.push_back(group.submit([&snapshot, container, &result, i]() {
+            howContai(snapshot, container, result, i);
+        }));
     }
-    for (auto& t : threads) {
-        t.join();
+    group.wait();
+    for (auto& task : tasks) {
+        task.get();
     }
     return std::accumulate(result.begin(), result.end(), result[0], [](int a, int b){return std::max(a,b);});
 }
 
 
 std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> Storage::find(std::string id){
+    return find(ContainerId::parse(id));
+}
+
+
+std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> Storage::find(ContainerId id){
+    std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> result;
+    switch(published.find(id, result)){
+        case PublishedIndex<ContainerPosition<int>, std::shared_ptr<IContainer>>::Lookup::Found:
+            return result;
+        case PublishedIndex<ContainerPosition<int>, std::shared_ptr<IContainer>>::Lookup::Missing:
+            throw std::runtime_error("Container not found");
+        default:
+            break;
+    }
+    ReadLock lock(*this);
     auto it = containers.findI(id);
     if(it.second == nullptr){
         throw std::runtime_error("Container not found");
@@ -561,78 +1207,60 @@ std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> Storage::find(std
 }
 
 
+std::vector<ContainerId> Storage::getListContainerIds() const{
+    std::vector<ContainerId> con;
+    ReadLock lock(*this);
+    con.reserve(containers.size());
+    containers.forEachEntry([&con](const BoundingBox<int>&, const std::shared_ptr<IContainer>& item){
+        con.push_back(item->getKey());
+    });
+    return con;
+}
+
+
 std::vector<std::string> Storage::getListContainers() const{
     std::vector<std::string> con;
-    for(auto it = containers.begin(); it != containers.end(); ++it){
-        if (*it == nullptr) {
-            std::cout << "Invalid container found.\n";
-            continue;
-        }
-        if(!(*it)->con.empty()){
-            for(auto it2 = (*it)->con.begin(); it2 != (*it)->con.end(); ++it2){
-                con.push_back((*it2).second->getId());
-            }
-        }
-    }
+    ReadLock lock(*this);
+    con.reserve(containers.size());
+    containers.forEachEntry([&con](const BoundingBox<int>&, const std::shared_ptr<IContainer>& item){
+        con.push_back(item->getId());
+    });
     return con;
 }
 
 
-void Storage::checkTemperature(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> pos){
+PlaceStatus Storage::checkTemperature(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> pos){
     auto ref = std::dynamic_pointer_cast<IRefragedContainer>(container);
     if(ref == nullptr){
-        return;
-    }
-    if(container == nullptr){
-        throw std::invalid_argument("Container is not refraged");
+        return PlaceStatus::Ok;
     }
     if(((*container).isType() == "Refraged" || (*container).isType() == "Fragile and Refraged Container") &&
     storage.temperature > (*ref).getMaxTemperature())
     {
-        throw std::invalid_argument("Container is too hot");
+        return PlaceStatus::TooHot;
     }
+    return PlaceStatus::Ok;
 }
 
 
-void Storage::checkPressure(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> pos){
+PlaceStatus Storage::checkPressure(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> pos){
     if(container == nullptr){
-        throw std::invalid_argument("Container is not fragile");
+        return PlaceStatus::InvalidContainer;
     }
     if(pos.LLDown.z != 1){
-        std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> con = storage.searchUnderContainer(pos);
-        if(con.empty() || con[0].first.LLDown.z != 1){
-            throw std::invalid_argument("Container can t fly 1");
-        }
-        if(!checkSupport(pos, con)){
-            throw std::invalid_argument("Support doesn t exist");
-        }
-        for(size_t i = 0; i < con.size(); i++){
-            ContainerPosition<int> check = con[i].first;
-            if(con[i].second == nullptr){
-                continue;
-            }
-            auto fragileContainer = std::dynamic_pointer_cast<IFragileContainer>(con[i].second);
-            if(fragileContainer == nullptr){
-                continue;
-            }
-            if((fragileContainer->isType() == "Fragile" || fragileContainer->isType() == "Fragile and Refraged Container") && calculatemass(con, i) + (container)->getMass() > fragileContainer->getMaxPressure()){
-                throw std::invalid_argument("Container would be too heavy");
+        if(!storage.isSupported(pos)){
+            if(storage.heightmap.maxTop(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos)) == 0){
+                return PlaceStatus::CantFly;
             }
+            return PlaceStatus::NoSupport;
         }
-    }
-}
-
-
-std::list<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> Storage::searchAllContainersUpper(std::list<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> lst){
-    for(auto it = lst.begin(); it != lst.end(); it++){
-        auto i = searchUpperContainer(it->first);
-        if(!i.empty()){
-            for(auto it2 = i.begin(); it2 != i.end(); it2++){
-                if(std::find(lst.begin(), lst.end(), *it2) == lst.end()){
-                    lst.push_back(*it2);
-                }
+        // Новый контейнер ляжет грузом на всех, кто под ним прямо или через других
+        std::vector<ContainerId> under = storage.containersUnder(Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>::toBox(pos));
+        for(auto& id : storage.support.closure(under, false)){
+            if(storage.support.load(id) + container->getMass() > storage.support.limit(id)){
+                return PlaceStatus::TooHeavy;
             }
         }
     }
-    return lst;
+    return PlaceStatus::Ok;
 }
\ No newline at end of file
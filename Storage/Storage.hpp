@@ -9,79 +9,254 @@
 #include <atomic>
 #include <shared_mutex>
 #include <iostream>
+#include <stop_token>
+#include <random>
+#include <span>
 #include "../Octree/Octree.hpp"
+#include "../Octree/PublishedIndex.hpp"
 #include "../Checker/Checker.hpp"
+#include "../ThreadPool/ThreadPool.hpp"
+#include "FreeSpace.hpp"
+#include "Heightmap.hpp"
+#include "PlacementStrategy.hpp"
+#include "Batch.hpp"
+#include "Transaction.hpp"
+#include "SupportGraph.hpp"
+#include "SharedMutex.hpp"
+#include "Snapshot.hpp"
+#include "RegionLocks.hpp"
+#include "PlacementLeases.hpp"
 
 
+// Потокобезопасность: читатели (find, getInfo, getListContainers, getALLcontainers,
+// запросы графа опор и нагрузки) работают параллельно под shared_mtx в режиме
+// shared, изменения склада идут по одному под эксклюзивной блокировкой.
+// Вставки по явным координатам (addContainer(X, Y, Z), tryAdd, dropContainer) и
+// простое удаление держат склад в режиме shared и замки своих полос пола
+// (RegionLocks), поэтому в непересекающихся полосах проверяются параллельно;
+// само изменение дерева и индексов идёт под короткой эксклюзивной structure_mtx.
+// Автоматическое размещение (placeContainer, tryPlace) ищет место так же под
+// shared, арендует выбранный бокс (PlacementLeases) и вставляет его как запись
+// по явным координатам. Партии, перемещения и каскадное удаление - эксклюзивно.
+// В режиме read-mostly (setReadMostly) find(id) не берёт блокировок вовсе: ответ
+// даёт опубликованный индекс id -> позиция, который писатели обновляют копированием.
+// Внешние проверки и оценки размещения вызываются под этой блокировкой и не должны
+// звать публичные методы того же склада.
 class Storage{
+    friend class StorageTransaction;
     private:
         int number;
         int length, width, height;
         double temperature;
-        Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> containers;
+        Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>> containers;
         Checker<int> checker;
+        SplitPolicy<int> splitPolicy;
+        std::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+        FreeSpace freeSpace;
+        Heightmap heightmap;
+        SupportGraph support;
+        PlacementStrategy placement = PlacementStrategy::FirstFit;
+        std::mt19937 random;
 
         public:
           int getLength(){
+            ReadLock lock(*this);
             return length;
           }
           int getWidth(){
+            ReadLock lock(*this);
             return width;
           }
           int getHeight(){
+            ReadLock lock(*this);
             return height;
           }     
           Storage(){}
           std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> getALLcontainers(){
+            ReadLock lock(*this);
             auto i = containers.searchDepth();
             return i;
           }
           void addExternalCheckFunction(const std::function<void(Storage&, std::shared_ptr<IContainer>, ContainerPosition<int>)>& externalFunc);
-          Storage(int number, int length, int width, int height, double temperature);
+          Storage(int number, int length, int width, int height, double temperature, SplitPolicy<int> policy = SplitPolicy<int>());
           Storage(const Storage& other);
           std::string addContainer(std::shared_ptr<IContainer> container);
+          ContainerId placeContainer(std::shared_ptr<IContainer> container);
+          std::string addContainer(std::shared_ptr<IContainer> container, PlacementStrategy strategy);
+          ContainerId placeContainer(std::shared_ptr<IContainer> container, PlacementStrategy strategy);
+          // Пробы без исключений: отказ возвращается кодом, контейнер при этом не добавляется
+          // Поиск места можно отменить через token, тогда вернётся PlaceStatus::Cancelled
+          PlaceStatus tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, std::stop_token token = {});
+          PlaceStatus tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, std::stop_token token = {});
+          PlaceStatus tryPlace(std::shared_ptr<IContainer> container, ContainerId& id, const PlacementScore& score, std::stop_token token = {});
+          // Партия за один проход; отказ одного контейнера не мешает остальным
+          std::vector<BatchResult> addContainers(std::span<const std::shared_ptr<IContainer>> batch, BatchPolicy policy = BatchPolicy());
+          // Оценка встроенной стратегии; пустая для FirstFit и RandomRestart, им оценка не нужна
+          static PlacementScore placementScore(PlacementStrategy strategy);
+          PlaceStatus tryAdd(std::shared_ptr<IContainer> container, int X, int Y, int Z);
           void moveContainer(std::string id, int X, int Y, int Z);
+          void moveContainer(ContainerId id, int X, int Y, int Z);
           void rotateContainer(std::string id, int method);
+          void rotateContainer(ContainerId id, int method);
           void removeContainer(std::string id);
+          void removeContainer(ContainerId id);
           std::string getInfo() const;
+          void getInfo(std::ostream& output) const;
+          // Контейнеры склада без копирования и без блокировки; ссылки действительны
+          // до следующего изменения склада, параллельно с писателями не использовать
+          auto containersView() const{
+            return containers.entries();
+          }
           int getTemperature() const{
+            ReadLock lock(*this);
             return temperature;
           }
+          // Кто стоит прямо на контейнере и на ком он стоит
+          std::vector<ContainerId> containersAbove(ContainerId id) const{
+            ReadLock lock(*this);
+            return support.above(id);
+          }
+          std::vector<ContainerId> containersBelow(ContainerId id) const{
+            ReadLock lock(*this);
+            return support.below(id);
+          }
+          // То же с учётом опоры через другие контейнеры
+          std::vector<ContainerId> allContainersAbove(ContainerId id) const{
+            ReadLock lock(*this);
+            return support.closure(id, true);
+          }
+          std::vector<ContainerId> allContainersBelow(ContainerId id) const{
+            ReadLock lock(*this);
+            return support.closure(id, false);
+          }
+          // Масса всего, что прямо или через других стоит на контейнере
+          double loadCarried(ContainerId id) const{
+            ReadLock lock(*this);
+            return support.load(id);
+          }
+          // Сколько ещё можно положить на контейнер; бесконечность, если он не хрупкий
+          double loadMargin(ContainerId id) const;
+          std::vector<std::pair<ContainerId, double>> loadMargins() const;
+          // Сколько точек-кандидатов сейчас рассматривает автоматическое размещение
+          size_t freeSpaceSize() const{
+            ReadLock lock(*this);
+            return freeSpace.size();
+          }
+          // Пул для параллельных операций склада, по умолчанию общий пул процесса
+          void setThreadPool(std::shared_ptr<ThreadPool> threadPool){
+            WriteLock lock(shared_mtx);
+            pool = threadPool;
+          }
+          std::shared_ptr<ThreadPool> getThreadPool() const{
+            ReadLock lock(*this);
+            return pool;
+          }
+          // Стратегия для вызовов без явной стратегии
+          void setPlacementStrategy(PlacementStrategy strategy){
+            WriteLock lock(shared_mtx);
+            placement = strategy;
+          }
+          PlacementStrategy getPlacementStrategy() const{
+            ReadLock lock(*this);
+            return placement;
+          }
+          // Поиск по id без блокировок ценой копирования части индекса на каждой записи;
+          // для складов, где запросов по id на порядки больше, чем изменений
+          void setReadMostly(bool enabled);
+          bool isReadMostly() const{
+            return published.enabled();
+          }
+          const SplitPolicy<int>& getSplitPolicy() const{
+            return splitPolicy;
+          }
+          // Снимок за O(1): отчёты и проверки "что если" без блокировки и копирования склада
+          StorageSnapshot snapshot() const;
           size_t howContainer(std::shared_ptr<IContainer> container);
           void addContainer(std::shared_ptr<IContainer>, int X, int Y, int Z);
+          ContainerId dropContainer(std::shared_ptr<IContainer> container, int X, int Y);
           void getSize(int l, int w, int h);
           std::string getInfoAboutStorage() const;
           std::vector<std::string> getListContainers() const;
+          std::vector<ContainerId> getListContainerIds() const;
           ~Storage(){
             }
 
           std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> find(std::string id);
+          std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> find(ContainerId id);
 
           Storage& operator=(const Storage& other);
 
 
         private:
-          std::mutex mtx;
-          mutable std::shared_mutex shared_mtx;
-          std::atomic<bool> containerAdded{false}; 
-          int calculateDepth();
-          static bool comparePosition(std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos1, std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos2);
-          static bool comparePositionReverse(std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos1, std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>& pos2);
+          // Кандидатов в одной порции параллельного поиска места
+          static constexpr size_t PlaceChunk = 16;
+          using SharedLock = std::shared_lock<SharedMutex>;
+          using WriteLock = std::unique_lock<SharedMutex>;
+          mutable SharedMutex shared_mtx;
+          // Дерево, свободное место, карта высот и граф опор; под эксклюзивной
+          // shared_mtx её не берут - кроме держателя там никого нет
+          mutable SharedMutex structure_mtx;
+          RegionLocks regions;
+          PlacementLeases leases;
+          PublishedIndex<ContainerPosition<int>, std::shared_ptr<IContainer>> published;
+          // Персистентная копия дерева для snapshot(). Собирается пакетно при первом
+          // снимке и дальше меняется вместе с containers; до него записи её не трогают
+          mutable StorageSnapshot::Tree versions;
+          mutable bool versionsBuilt = false;
+          mutable std::mutex versions_mtx;
+          Storage(const Storage& other, bool cloneItems);
+          std::mutex random_mtx;
+          // Сколько раз параллельное размещение повторяет поиск, если место перехватили
+          static constexpr int PlaceAttempts = 64;
+          // Читатель держит склад и структуру в режиме shared: структуру в это
+          // время может менять только писатель своей полосы
+          struct ReadLock{
+              SharedLock storage;
+              SharedLock structure;
+              explicit ReadLock(const Storage& owner) : storage(owner.shared_mtx), structure(owner.structure_mtx) {}
+          };
+          PlaceStatus addInRegion(std::shared_ptr<IContainer> container, int X, int Y, int Z, bool drop, std::exception_ptr* rejection = nullptr);
+          bool removeInRegion(ContainerId id);
+          PlaceStatus placeShared(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token);
+          size_t selectPlace(std::shared_ptr<IContainer> container, std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token, std::atomic<bool>& leaseBlocked);
+          void widenToSupport(const std::vector<ContainerId>& ids, int& minX, int& maxX);
+          PlaceStatus placeLocked(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, std::stop_token token);
+          PlaceStatus addLocked(std::shared_ptr<IContainer> container, int X, int Y, int Z);
+          void putContainer(std::shared_ptr<IContainer> container, const ContainerPosition<int>& pos, Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node* node);
+          bool takeContainer(ContainerId id);
+          void restoreContainer(const ContainerPosition<int>& pos, std::shared_ptr<IContainer> container);
+          PlaceStatus probePlace(std::shared_ptr<IContainer> container, int X, int Y, int Z, ContainerPosition<int>& pos, Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>>::Node*& node, std::exception_ptr* rejection = nullptr);
+          void runChunks(size_t count, std::stop_token token, const std::function<bool(size_t, size_t)>& body);
+          size_t findPlace(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, std::stop_token token, std::atomic<bool>& leaseBlocked);
+          size_t scorePlace(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, std::vector<PlaceStatus>& statuses, const PlacementScore& score, std::stop_token token, std::atomic<bool>& leaseBlocked);
+          PlaceStatus searchPlace(std::shared_ptr<IContainer> container, ContainerId& id, PlacementStrategy strategy, const PlacementScore& score, std::stop_token token, bool& noRoom);
+          std::vector<size_t> batchOrder(std::span<const std::shared_ptr<IContainer>> batch, BatchOrder order);
+          PlaceStatus placeBest(std::shared_ptr<IContainer> container, const std::vector<Point<int>>& candidates, const std::vector<PlaceStatus>& statuses, size_t best, std::stop_token token, ContainerId& id);
+          size_t contactArea(const ContainerPosition<int>& position);
+          void occupyFreeSpace(const ContainerPosition<int>& position);
+          void releaseFreeSpace(const ContainerPosition<int>& position);
+          void addFreePoint(const Point<int>& p);
+          int restZ(int x, int y, int z);
+          void rebuildFreeSpace();
+          void loadContainers(const std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>>& items, bool clone);
           bool isNoTop(const ContainerPosition<int>& position);
-          std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> searchUnderContainer(ContainerPosition<int>& position);
-          static double calculatemass(std::vector<std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>>> con, size_t it);
-          bool addContainerR(std::shared_ptr<IContainer> container,  int yStart, int yEnd);
+          std::vector<ContainerId> containersUnder(const BoundingBox<int>& box);
+          static double loadLimit(const std::shared_ptr<IContainer>& container);
           ContainerPosition<int> calculateContainerPosition(int x, int y, int z, int l, int w, int h);
           bool moveContainer(std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> it);
           std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> isTop(const ContainerPosition<int>& position);
-           void multitread(std::shared_ptr<IContainer> container, int X, int Y, int Z);
-           std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> searchUpperContainer(ContainerPosition<int>& position);
-           void howContai(std::shared_ptr<IContainer> container, std::vector<size_t>& result, size_t method);
-           static bool checkSupport(ContainerPosition<int>& position, std::vector<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> con);
-           static void checkTemperature(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position);
-           static void checkPressure(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position);
-
-           std::list<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> searchAllContainersUpper(std::list<std::pair<ContainerPosition<int>,std::shared_ptr<IContainer>>> dec);
+           static void howContai(const Storage& source, std::shared_ptr<IContainer> container, std::vector<size_t>& result, size_t method);
+           bool isSupported(const ContainerPosition<int>& position);
+           bool supportedAt(const Point<int>& p);
+           void lowerHeightmap(const ContainerPosition<int>& position);
+           void rebuildHeightmap();
+           void linkSupport(const ContainerPosition<int>& position, const std::shared_ptr<IContainer>& container, bool linkAbove);
+           void rebuildSupportGraph();
+           static PlaceStatus checkTemperature(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position);
+           static PlaceStatus checkPressure(Storage& storage, std::shared_ptr<IContainer> container, ContainerPosition<int> position);
+           static double scoreBottomLeftBack(Storage& storage, std::shared_ptr<IContainer> container, const ContainerPosition<int>& position);
+           static double scoreBestFit(Storage& storage, std::shared_ptr<IContainer> container, const ContainerPosition<int>& position);
+           static double scoreLowestHeight(Storage& storage, std::shared_ptr<IContainer> container, const ContainerPosition<int>& position);
 
           
 
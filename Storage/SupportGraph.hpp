@@ -0,0 +1,159 @@
+#ifndef SUPPORTGRAPH_HPP
+#define SUPPORTGRAPH_HPP
+
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "../Container/I/ContainerId.hpp"
+
+
+// Граф "стоит на": ребро below -> above, если крыша below ровно под дном above
+// и их основания пересекаются. Граф ацикличен - ребро всегда ведёт вверх.
+// Склад обновляет его при каждой вставке и снятии контейнера.
+// Для каждого контейнера хранится нагрузка - суммарная масса всего,
+// что прямо или через других стоит на нём, и допустимый предел нагрузки.
+class SupportGraph{
+    public:
+        static constexpr double NoLimit = std::numeric_limits<double>::infinity();
+
+    private:
+        struct Links{
+            std::vector<ContainerId> above;
+            std::vector<ContainerId> below;
+            double mass = 0;
+            double load = 0;
+            double limit = NoLimit;
+        };
+
+        std::unordered_map<ContainerId, Links> links;
+
+        static void unlink(std::vector<ContainerId>& list, ContainerId id){
+            list.erase(std::remove(list.begin(), list.end(), id), list.end());
+        }
+
+        const std::vector<ContainerId>& list(ContainerId id, bool up) const{
+            static const std::vector<ContainerId> empty;
+            auto it = links.find(id);
+            if(it == links.end()){
+                return empty;
+            }
+            return up ? it->second.above : it->second.below;
+        }
+
+    public:
+        void clear(){
+            links.clear();
+        }
+
+        void add(ContainerId id, double mass = 0, double limit = NoLimit){
+            Links& node = links[id];
+            node.mass = mass;
+            node.limit = limit;
+        }
+
+        void link(ContainerId below, ContainerId above){
+            links[below].above.push_back(above);
+            links[above].below.push_back(below);
+        }
+
+        void remove(ContainerId id){
+            auto it = links.find(id);
+            if(it == links.end()){
+                return;
+            }
+            for(auto& above : it->second.above){
+                unlink(links[above].below, id);
+            }
+            for(auto& below : it->second.below){
+                unlink(links[below].above, id);
+            }
+            links.erase(it);
+        }
+
+        const std::vector<ContainerId>& above(ContainerId id) const{
+            return list(id, true);
+        }
+
+        const std::vector<ContainerId>& below(ContainerId id) const{
+            return list(id, false);
+        }
+
+        // Все контейнеры, которые прямо или через других опираются на id (up)
+        // или на которые опирается id (!up), в порядке обхода в ширину
+        std::vector<ContainerId> closure(ContainerId id, bool up) const{
+            std::vector<ContainerId> result = closure(std::vector<ContainerId>{id}, up);
+            result.erase(result.begin());
+            return result;
+        }
+
+        // То же от нескольких контейнеров сразу, сами они входят в результат
+        std::vector<ContainerId> closure(const std::vector<ContainerId>& from, bool up) const{
+            std::vector<ContainerId> result;
+            std::unordered_set<ContainerId> visited;
+            for(auto& id : from){
+                if(visited.insert(id).second){
+                    result.push_back(id);
+                }
+            }
+            for(size_t i = 0; i < result.size(); ++i){
+                for(auto& next : list(result[i], up)){
+                    if(visited.insert(next).second){
+                        result.push_back(next);
+                    }
+                }
+            }
+            return result;
+        }
+
+        double load(ContainerId id) const{
+            auto it = links.find(id);
+            return it == links.end() ? 0 : it->second.load;
+        }
+
+        double limit(ContainerId id) const{
+            auto it = links.find(id);
+            return it == links.end() ? NoLimit : it->second.limit;
+        }
+
+        // Масса id добавляется (или снимается при delta < 0) всем, на ком он стоит.
+        // Годится, пока на самом id ничего не стоит, иначе нужен recount.
+        void carry(ContainerId id, double delta){
+            for(auto& below : closure(id, false)){
+                links[below].load += delta;
+            }
+        }
+
+        // Пересчёт нагрузки с нуля по текущим рёбрам
+        void recount(const std::vector<ContainerId>& ids){
+            for(auto& id : ids){
+                auto it = links.find(id);
+                if(it == links.end()){
+                    continue;
+                }
+                double load = 0;
+                for(auto& above : closure(id, true)){
+                    load += links.at(above).mass;
+                }
+                it->second.load = load;
+            }
+        }
+
+        std::vector<ContainerId> ids() const{
+            std::vector<ContainerId> result;
+            result.reserve(links.size());
+            for(auto& [id, node] : links){
+                result.push_back(id);
+            }
+            return result;
+        }
+
+        size_t size() const{
+            return links.size();
+        }
+};
+
+
+#endif
@@ -0,0 +1,61 @@
+#include "Transaction.hpp"
+#include "Storage.hpp"
+#include <iostream>
+#include <stdexcept>
+
+
+StorageTransaction::StorageTransaction(Storage& storage) : storage(storage), lock(storage.shared_mtx) {}
+
+
+StorageTransaction::StorageTransaction(Storage& storage, std::defer_lock_t) : storage(storage) {}
+
+
+StorageTransaction::~StorageTransaction(){
+    try{
+        rollback();
+    }catch(std::exception& e){
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+
+ContainerId StorageTransaction::place(std::shared_ptr<IContainer> container){
+    ContainerId id;
+    if(storage.placeLocked(container, id, storage.placement, std::stop_token()) == PlaceStatus::Ok){
+        log.push_back(Undo{Action::Put, storage.containers.findI(id).first, container});
+    }
+    return id;
+}
+
+
+bool StorageTransaction::take(ContainerId id){
+    auto item = storage.containers.findI(id);
+    if(item.second == nullptr || !storage.takeContainer(id)){
+        return false;
+    }
+    log.push_back(Undo{Action::Take, item.first, item.second});
+    return true;
+}
+
+
+void StorageTransaction::commit(){
+    log.clear();
+}
+
+
+// Склад возвращается ровно в состояние до транзакции, поэтому место под снятые
+// контейнеры гарантированно свободно и проверки не нужны
+void StorageTransaction::rollback(){
+    for(auto it = log.rbegin(); it != log.rend(); ++it){
+        if(it->action == Action::Put){
+            storage.takeContainer(it->container->getKey());
+        }else{
+            auto node = storage.containers.SearchInsert(it->container, it->position);
+            if(node == nullptr){
+                throw std::logic_error("Transaction rollback: place of container " + it->container->getId() + " is taken");
+            }
+            storage.putContainer(it->container, it->position, node);
+        }
+    }
+    log.clear();
+}
@@ -0,0 +1,60 @@
+#ifndef TRANSACTION_HPP
+#define TRANSACTION_HPP
+
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include "../Container/I/IContainer.hpp"
+#include "../Octree/ContainerPosition.hpp"
+#include "SharedMutex.hpp"
+
+
+class Storage;
+
+
+// Транзакция над складом. Каждое изменение пишется в журнал отмены: commit()
+// только очищает журнал, rollback() проигрывает его в обратном порядке
+// без проверок и поиска места. Незакрытая транзакция откатывается в деструкторе.
+// Всё время жизни транзакция держит склад на эксклюзивной блокировке.
+class StorageTransaction{
+    friend class Storage;
+    private:
+        enum class Action{
+            Put,
+            Take
+        };
+
+        struct Undo{
+            Action action;
+            ContainerPosition<int> position;
+            std::shared_ptr<IContainer> container;
+        };
+
+        Storage& storage;
+        std::unique_lock<SharedMutex> lock;
+        std::vector<Undo> log;
+
+        // Для методов склада, которые уже держат блокировку сами
+        StorageTransaction(Storage& storage, std::defer_lock_t);
+
+    public:
+        explicit StorageTransaction(Storage& storage);
+        StorageTransaction(const StorageTransaction&) = delete;
+        StorageTransaction& operator=(const StorageTransaction&) = delete;
+        ~StorageTransaction();
+
+        // Автоматическое размещение; при неудаче ничего не меняется и в журнал не пишется
+        ContainerId place(std::shared_ptr<IContainer> container);
+        // Снимает контейнер со склада без проверок; false, если такого нет
+        bool take(ContainerId id);
+        void commit();
+        void rollback();
+
+        size_t size() const{
+            return log.size();
+        }
+};
+
+
+#endif
@@ -4,6 +4,7 @@ void Terminal::add(int id, Storage* storage){
     if(terminal.find(id) != terminal.end()){
         throw std::invalid_argument("Terminal already");
     }
+    storage->setThreadPool(pool);
     terminal[id] = storage;
 }
 
@@ -27,7 +28,8 @@ void Terminal::getallInfo(std::ostream& output){
         int id = entry.first;
         Storage* storage = entry.second;
         output << "Storage ID: " << id << std::endl;
-        std::cout << storage->getInfo() << std::endl;
+        storage->getInfo(output);
+        output << std::endl;
     }
 }
 
@@ -10,7 +10,9 @@
 class Terminal{
     private:
         std::map<int, Storage*> terminal;
+        std::shared_ptr<ThreadPool> pool;
     public:
+        explicit Terminal(std::shared_ptr<ThreadPool> pool = ThreadPool::shared()) : pool(pool) {}
         void add(int id, Storage* storage);
         void remove(int id);
         void setsizeStorage(int id, int length, int width, int height);
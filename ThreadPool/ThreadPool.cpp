@@ -0,0 +1,110 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(size_t threads){
+    if(threads == 0){
+        threads = 1;
+    }
+    workers.reserve(threads);
+    for(size_t i = 0; i < threads; ++i){
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+
+ThreadPool::~ThreadPool(){
+    shutdown();
+}
+
+
+std::shared_ptr<ThreadPool> ThreadPool::shared(){
+    static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>();
+    return pool;
+}
+
+
+void ThreadPool::work(){
+    while(true){
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            available.wait(lock, [this](){ return stopping || !tasks.empty(); });
+            if(tasks.empty()){
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task.run();
+        finish(task.group);
+    }
+}
+
+
+void ThreadPool::enqueue(std::function<void()> run, TaskGroup* group){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stopping){
+            throw std::runtime_error("Thread pool is shut down");
+        }
+        tasks.push_back(Task{std::move(run), group});
+        if(group != nullptr){
+            ++group->unfinished;
+            group->done.notify_all();
+        }
+    }
+    available.notify_one();
+}
+
+
+void ThreadPool::finish(TaskGroup* group){
+    if(group == nullptr){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if(--group->unfinished == 0){
+        group->done.notify_all();
+    }
+}
+
+
+void ThreadPool::TaskGroup::wait(){
+    std::unique_lock<std::mutex> lock(pool.mtx);
+    while(unfinished != 0){
+        auto it = std::find_if(pool.tasks.begin(), pool.tasks.end(), [this](const Task& task){ return task.group == this; });
+        if(it == pool.tasks.end()){
+            done.wait(lock);
+            continue;
+        }
+        Task task = std::move(*it);
+        pool.tasks.erase(it);
+        lock.unlock();
+        task.run();
+        pool.finish(this);
+        lock.lock();
+    }
+}
+
+
+void ThreadPool::shutdown(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(stopping){
+            return;
+        }
+        stopping = true;
+    }
+    available.notify_all();
+    for(auto& worker : workers){
+        if(worker.joinable()){
+            worker.join();
+        }
+    }
+}
+
+
+size_t ThreadPool::pending() const{
+    std::lock_guard<std::mutex> lock(mtx);
+    return tasks.size();
+}
@@ -0,0 +1,104 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+
+// Постоянный пул потоков для параллельных операций склада. Задача возвращает
+// std::future. Кто ждёт свои задачи, ставит их через TaskGroup: wait() группы
+// сам выполняет ещё не взятые задачи только этой группы и спит на condition
+// variable, поэтому вложенные задачи не блокируют пул даже из одного потока,
+// а чужие задачи не выполняются под блокировками ждущего.
+class ThreadPool{
+    public:
+        class TaskGroup;
+
+    private:
+        struct Task{
+            std::function<void()> run;
+            TaskGroup* group = nullptr;
+        };
+
+        std::vector<std::thread> workers;
+        std::deque<Task> tasks;
+        mutable std::mutex mtx;
+        std::condition_variable available;
+        bool stopping = false;
+
+        void work();
+        void enqueue(std::function<void()> run, TaskGroup* group);
+        void finish(TaskGroup* group);
+
+        template <typename F>
+        auto package(F&& func, TaskGroup* group) -> std::future<std::invoke_result_t<std::decay_t<F>>>{
+            using Result = std::invoke_result_t<std::decay_t<F>>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+            std::future<Result> result = task->get_future();
+            enqueue([task](){ (*task)(); }, group);
+            return result;
+        }
+
+    public:
+        explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        // Общий пул процесса по числу ядер
+        static std::shared_ptr<ThreadPool> shared();
+
+        // Задача без ожидания через пул; результат - через future
+        template <typename F>
+        auto submit(F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>>>{
+            return package(std::forward<F>(func), nullptr);
+        }
+
+        // Задачи одного вызова. Разрушение группы дожидается всех её задач,
+        // исключения задач приходят через их future.
+        class TaskGroup{
+            friend class ThreadPool;
+            private:
+                ThreadPool& pool;
+                size_t unfinished = 0;          // под pool.mtx
+                std::condition_variable done;   // с pool.mtx
+
+            public:
+                explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+                TaskGroup(const TaskGroup&) = delete;
+                TaskGroup& operator=(const TaskGroup&) = delete;
+
+                ~TaskGroup(){
+                    wait();
+                }
+
+                template <typename F>
+                auto submit(F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>>>{
+                    return pool.package(std::forward<F>(func), this);
+                }
+
+                // Выполняет в своём потоке ещё не взятые задачи группы, затем ждёт остальные
+                void wait();
+        };
+
+        // Доделывает уже поставленные задачи и останавливает потоки; новые задачи не принимаются
+        void shutdown();
+
+        size_t size() const{
+            return workers.size();
+        }
+
+        size_t pending() const;
+};
+
+
+#endif
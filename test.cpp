@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <set>
 #include "./Terminal/Terminal.hpp"
 #include "./Storage/Storage.hpp"
 #include "./Container/Container.hpp"
@@ -201,6 +202,288 @@ TEST(StorageTest, Remove){
 }
 
 
+TEST(StorageTest, TransactionRollback){
+    Storage st(2, 12, 3, 5, 20.0);
+    st.addContainer(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), 1, 1, 1);
+    st.addContainer(std::make_shared<Container>("_", "Cargo A", 8, 1, 1, 21.2, 1.1), 3, 1, 1);
+    std::shared_ptr<IContainer> top = std::make_shared<Container>("_", "Cargo A", 10, 1, 1, 21.2, 1.1);
+    st.addContainer(top, 1, 1, 3);
+    auto ids = st.getListContainerIds();
+    size_t freeSpace = st.freeSpaceSize();
+    EXPECT_THROW(st.removeContainer("3_1_1"), std::invalid_argument);
+    // Откат возвращает те же объекты на те же места, а не копии
+    EXPECT_EQ(st.find("1_1_3").second, top);
+    EXPECT_EQ(st.getListContainerIds(), ids);
+    EXPECT_EQ(st.freeSpaceSize(), freeSpace);
+    {
+        StorageTransaction transaction(st);
+        EXPECT_TRUE(transaction.take(top->getKey()));
+        EXPECT_FALSE(transaction.take(ContainerId(7, 7, 7)));
+        EXPECT_TRUE(transaction.place(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1)).valid());
+        EXPECT_EQ(transaction.size(), 2);
+    }
+    EXPECT_EQ(st.getListContainerIds(), ids);
+    {
+        StorageTransaction transaction(st);
+        transaction.take(top->getKey());
+        transaction.commit();
+    }
+    EXPECT_EQ(st.getListContainerIds().size(), 2);
+}
+
+
+TEST(StorageTest, SupportGraph){
+    auto sorted = [](std::vector<ContainerId> ids){
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    Storage storage(1, 50, 50, 20, 20.0);
+    ContainerId a(1, 1, 1), b(1, 1, 3), c(1, 1, 5), d(12, 1, 1), e(6, 1, 3);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1), 1, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 1, 1, 3);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 1, 1, 5);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1), 12, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 15, 4, 1, 21.2, 1.1), 6, 1, 3);
+    EXPECT_EQ(sorted(storage.containersAbove(a)), sorted({b, e}));
+    EXPECT_EQ(sorted(storage.containersBelow(e)), sorted({a, d}));
+    EXPECT_EQ(sorted(storage.allContainersAbove(a)), sorted({b, c, e}));
+    EXPECT_EQ(sorted(storage.allContainersBelow(c)), sorted({a, b}));
+    EXPECT_TRUE(storage.containersAbove(c).empty());
+    Storage copy = storage;
+    EXPECT_EQ(sorted(copy.allContainersAbove(a)), sorted({b, c, e}));
+    storage.removeContainer(b);
+    // C снят и поставлен заново - первое свободное место как раз на месте B
+    EXPECT_EQ(storage.containersBelow(b), std::vector<ContainerId>{a});
+    EXPECT_TRUE(storage.containersBelow(c).empty());
+    EXPECT_EQ(storage.getListContainerIds().size(), 4);
+    for(auto& id : storage.getListContainerIds()){
+        if(id.getZ() > 1){
+            EXPECT_FALSE(storage.containersBelow(id).empty());
+        }
+    }
+    EXPECT_EQ(sorted(storage.containersBelow(e)), sorted({a, d}));
+}
+
+
+TEST(StorageTest, SupportGraphAfterMoveAndRotate){
+    Storage storage(1, 50, 50, 20, 20.0);
+    ContainerId a(1, 1, 1), b(1, 1, 3), moved(20, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1), 1, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 1, 1, 3);
+    // Неудачные перемещение и поворот возвращают B без дублирования рёбер
+    EXPECT_THROW(storage.moveContainer(b, 48, 1, 1), std::invalid_argument);
+    EXPECT_THROW(storage.moveContainer(a, 30, 1, 1), std::invalid_argument);
+    EXPECT_EQ(storage.containersAbove(a), std::vector<ContainerId>{b});
+    EXPECT_EQ(storage.containersBelow(b), std::vector<ContainerId>{a});
+    storage.rotateContainer(b, 1);
+    EXPECT_EQ(storage.containersAbove(a), std::vector<ContainerId>{b});
+    EXPECT_EQ(storage.containersBelow(b), std::vector<ContainerId>{a});
+    EXPECT_EQ(storage.getListContainerIds().size(), 2);
+    storage.moveContainer(b, 20, 1, 1);
+    EXPECT_TRUE(storage.containersAbove(a).empty());
+    EXPECT_TRUE(storage.containersBelow(moved).empty());
+    EXPECT_TRUE(storage.allContainersBelow(b).empty());
+    EXPECT_EQ(storage.getListContainerIds().size(), 2);
+    storage.removeContainer(a);
+    EXPECT_EQ(storage.getListContainerIds(), std::vector<ContainerId>{moved});
+}
+
+TEST(StorageTest, LoadAfterMove){
+    Storage storage(1, 50, 50, 20, 20.0);
+    ContainerId fragile(1, 1, 1), weight(1, 1, 3);
+    storage.addContainer(std::make_shared<FragileContainer>("_", "Cargo B", 10, 10, 1, 23.5, 2.0, 8.0), 1, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 7.0), 1, 1, 3);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 7.0);
+    EXPECT_THROW(storage.moveContainer(weight, 48, 1, 1), std::invalid_argument);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 7.0);
+    storage.moveContainer(weight, 20, 1, 1);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 0.0);
+    EXPECT_DOUBLE_EQ(storage.loadMargin(fragile), 8.0);
+    // Освободившийся запас снова доступен
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 7.5), 1, 1, 3), PlaceStatus::Ok);
+}
+
+TEST(StorageTest, CumulativeLoad){
+    Storage storage(1, 50, 50, 20, 20.0);
+    ContainerId fragile(1, 1, 1), middle(1, 1, 3), top(1, 1, 5);
+    storage.addContainer(std::make_shared<FragileContainer>("_", "Cargo B", 10, 10, 1, 23.5, 2.0, 5.0), 1, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 8, 8, 1, 21.2, 3.0), 1, 1, 3);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 3.0);
+    EXPECT_DOUBLE_EQ(storage.loadMargin(fragile), 2.0);
+    EXPECT_EQ(storage.loadMargin(middle), std::numeric_limits<double>::infinity());
+    // Верхний давит на хрупкий через средний
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 3.0), 1, 1, 5), PlaceStatus::TooHeavy);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.5), 1, 1, 5), PlaceStatus::Ok);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 4.5);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(middle), 1.5);
+    auto margins = storage.loadMargins();
+    ASSERT_EQ(margins.size(), 1);
+    EXPECT_EQ(margins[0].first, fragile);
+    EXPECT_DOUBLE_EQ(margins[0].second, 0.5);
+    storage.removeContainer(top);
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), 3.0);
+    Storage copy = storage;
+    EXPECT_DOUBLE_EQ(copy.loadCarried(fragile), 3.0);
+    // Снятие среднего переставляет верхний, нагрузка пересчитывается
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.0), 1, 1, 5);
+    storage.removeContainer(middle);
+    double expected = 0;
+    for(auto& id : storage.allContainersAbove(fragile)){
+        expected += storage.find(id).second->getMass();
+    }
+    EXPECT_DOUBLE_EQ(storage.loadCarried(fragile), expected);
+}
+
+
+TEST(StorageTest, PackedIds){
+    ContainerId id(81, 2047, 3);
+    EXPECT_EQ(id.getX(), 81);
+    EXPECT_EQ(id.getY(), 2047);
+    EXPECT_EQ(id.getZ(), 3);
+    EXPECT_EQ(id.toString(), "81_2047_3");
+    EXPECT_TRUE(ContainerId::parse("81_2047_3") == id);
+    EXPECT_FALSE(ContainerId().valid());
+    EXPECT_EQ(ContainerId().toString(), "_");
+    EXPECT_THROW(ContainerId::parse("81_2047"), std::invalid_argument);
+    EXPECT_THROW(ContainerId::parse("1_-1_1"), std::invalid_argument);
+    Storage storage(1, 100, 100, 100, 20.0);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 7, 4, 3, 21.2, 1.1), 81, 81, 1);
+    ContainerId placed = storage.placeContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1));
+    ASSERT_TRUE(placed.valid());
+    EXPECT_EQ(storage.find(placed).second->getKey(), placed);
+    storage.moveContainer(ContainerId(81, 81, 1), 10, 10, 1);
+    EXPECT_THROW(storage.find(ContainerId(81, 81, 1)), std::runtime_error);
+    EXPECT_EQ(storage.find(ContainerId(10, 10, 1)).second->getId(), "10_10_1");
+    storage.removeContainer(ContainerId(10, 10, 1));
+    auto ids = storage.getListContainerIds();
+    ASSERT_EQ(ids.size(), 1);
+    EXPECT_EQ(ids[0], placed);
+}
+
+
+TEST(StorageTest, FreeSpacePlacement){
+    Storage storage(1, 200, 200, 20, 20.0);
+    std::vector<std::string> ids;
+    for(int i = 0; i < 40; ++i){
+        ids.push_back(storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1)));
+    }
+    // Порядок тот же, что у прежнего перебора: сначала стопка в (1, 1), потом следующая по x
+    EXPECT_EQ(ids[0], "1_1_1");
+    EXPECT_EQ(ids[1], "1_1_3");
+    EXPECT_EQ(ids[8], "1_1_17");
+    EXPECT_EQ(ids[9], "12_1_1");
+    EXPECT_EQ(ids[36], "45_1_1");
+    EXPECT_LT(storage.freeSpaceSize(), 100);
+    storage.removeContainer(ids[8]);
+    EXPECT_EQ(storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1)), "1_1_17");
+    Storage copy = storage;
+    EXPECT_EQ(copy.freeSpaceSize(), storage.freeSpaceSize());
+}
+
+
+TEST(StorageTest, ParallelPlacementIsDeterministic){
+    auto fill = [](std::shared_ptr<ThreadPool> pool){
+        Storage storage(1, 120, 120, 12, 20.0);
+        storage.setThreadPool(pool);
+        std::vector<std::string> ids;
+        for(int i = 0; i < 60; ++i){
+            ids.push_back(storage.addContainer(std::make_shared<Container>("_", "Cargo A", 5 + i % 7, 4 + i % 5, 1 + i % 3, 21.2, 1.1)));
+        }
+        return ids;
+    };
+    auto single = fill(std::make_shared<ThreadPool>(1));
+    EXPECT_EQ(single, fill(std::make_shared<ThreadPool>(4)));
+    EXPECT_EQ(single[0], "1_1_1");
+
+    Storage storage(1, 50, 50, 20, 20.0);
+    std::stop_source stop;
+    stop.request_stop();
+    ContainerId id;
+    EXPECT_EQ(storage.tryPlace(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), id, stop.get_token()), PlaceStatus::Cancelled);
+    EXPECT_FALSE(id.valid());
+    EXPECT_EQ(storage.tryPlace(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), id), PlaceStatus::Ok);
+    EXPECT_EQ(id.toString(), "1_1_1");
+}
+
+
+TEST(StorageTest, PlacementStrategies){
+    auto box = [](){ return std::make_shared<Container>("_", "Cargo A", 10, 10, 1, 21.2, 1.1); };
+    auto small = [](){ return std::make_shared<Container>("_", "Cargo A", 5, 5, 1, 21.2, 1.1); };
+    Storage storage(1, 200, 200, 20, 20.0);
+    storage.addContainer(box(), 5, 5, 1);
+    // Первая подходящая точка - на крыше, но сбоку касание с соседом больше
+    EXPECT_EQ(storage.addContainer(small(), PlacementStrategy::BestFit), "16_5_1");
+    EXPECT_EQ(storage.addContainer(small(), PlacementStrategy::FirstFit), "5_5_3");
+    EXPECT_EQ(storage.addContainer(small(), PlacementStrategy::BottomLeftBack), "5_16_1");
+    EXPECT_EQ(storage.addContainer(small(), PlacementStrategy::LowestHeight), "22_5_1");
+    ContainerId id;
+    PlacementScore farthest = [](Storage&, std::shared_ptr<IContainer>, const ContainerPosition<int>& pos){
+        return -static_cast<double>(pos.LLDown.x + pos.LLDown.y);
+    };
+    EXPECT_EQ(storage.tryPlace(box(), id, farthest), PlaceStatus::Ok);
+    EXPECT_EQ(id.toString(), "28_5_1");
+    storage.setPlacementStrategy(PlacementStrategy::RandomRestart);
+    for(int i = 0; i < 5; ++i){
+        EXPECT_NE(storage.addContainer(box()), "_");
+    }
+
+    auto fill = [&box](std::shared_ptr<ThreadPool> pool){
+        Storage storage(1, 80, 80, 10, 20.0);
+        storage.setThreadPool(pool);
+        storage.setPlacementStrategy(PlacementStrategy::BestFit);
+        std::vector<std::string> ids;
+        for(int i = 0; i < 30; ++i){
+            ids.push_back(storage.addContainer(box()));
+        }
+        return ids;
+    };
+    EXPECT_EQ(fill(std::make_shared<ThreadPool>(1)), fill(std::make_shared<ThreadPool>(3)));
+}
+
+
+TEST(StorageTest, BatchInsertion){
+    Storage storage(1, 30, 30, 10, 20.0);
+    std::vector<std::shared_ptr<IContainer>> batch = {
+        std::make_shared<FragileContainer>("_", "Cargo B", 5, 5, 2, 23.5, 2.5, 100.0),
+        std::make_shared<Container>("_", "Cargo A", 40, 5, 1, 21.2, 1.1),
+        std::make_shared<Container>("_", "Cargo A", 10, 10, 2, 21.2, 1.1),
+        std::make_shared<RefragedContainer>("_", "Cargo A", 4, 4, 1, 21.2, 2.1, 13.1),
+        nullptr,
+        std::make_shared<Container>("_", "Cargo A", 41, 6, 1, 21.2, 1.1),
+        std::make_shared<Container>("_", "Cargo A", 5, 5, 2, 21.2, 1.1)
+    };
+    auto results = storage.addContainers(batch, BatchPolicy{BatchOrder::Fragility, PlacementStrategy::FirstFit});
+    ASSERT_EQ(results.size(), batch.size());
+    // Итоги в порядке партии, хотя размещались сначала крупные нехрупкие
+    EXPECT_EQ(results[2].status, PlaceStatus::Ok);
+    EXPECT_EQ(results[2].id.toString(), "1_1_1");
+    EXPECT_EQ(results[6].id.toString(), "1_1_4");
+    EXPECT_EQ(results[0].status, PlaceStatus::Ok);
+    EXPECT_EQ(results[0].container, batch[0]);
+    EXPECT_EQ(results[1].status, PlaceStatus::NoPlace);
+    EXPECT_EQ(results[5].status, PlaceStatus::NoPlace);
+    EXPECT_EQ(results[3].status, PlaceStatus::TooHot);
+    EXPECT_EQ(results[4].status, PlaceStatus::InvalidContainer);
+    EXPECT_FALSE(results[1].id.valid());
+    EXPECT_EQ(storage.getListContainerIds().size(), 3);
+}
+
+
+TEST(StorageTest, DropContainer){
+    Storage storage(1, 50, 50, 20, 20.0);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 10, 10, 2, 21.2, 1.1), 1, 1, 1);
+    EXPECT_EQ(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 2, 2).toString(), "2_2_4");
+    EXPECT_EQ(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 20, 20).toString(), "20_20_1");
+    EXPECT_EQ(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 7, 7).toString(), "7_7_4");
+    EXPECT_THROW(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 11, 1), std::invalid_argument);
+    EXPECT_THROW(storage.moveContainer("1_1_1", 30, 30, 1), std::invalid_argument);
+    storage.removeContainer("2_2_4");
+    EXPECT_EQ(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 2, 2).toString(), "2_2_4");
+    EXPECT_NO_THROW(storage.moveContainer("20_20_1", 30, 30, 1));
+    EXPECT_EQ(storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), 31, 31).toString(), "31_31_3");
+}
+
+
  TEST(StorageTest, howContainersInStorage){
      Storage storage(1, 10, 5, 3, 20.0);
      std::shared_ptr<IContainer> container = std::make_shared<Container>("_", "Cargo B", 2, 1, 1, 23.5, 2.5);
@@ -228,6 +511,39 @@ TEST(StorageTest, Checker){
 
 
 
+TEST(StorageTest, PlaceStatusCodes){
+    Storage storage(1, 20, 20, 10, 20.0);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<RefragedContainer>("_", "Cargo A", 4, 10, 1, 21.2, 2.1, 13.1), 1, 1, 1), PlaceStatus::TooHot);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 0, 1, 1), PlaceStatus::InvalidCoordinates);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 1, 1, 3), PlaceStatus::CantFly);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<FragileContainer>("_", "Cargo B", 4, 4, 2, 23.5, 2.5, 1.3), 1, 1, 1), PlaceStatus::Ok);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 2, 2, 1), PlaceStatus::NoPlace);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 5.1), 1, 1, 4), PlaceStatus::TooHeavy);
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 6, 2, 1, 21.2, 1.1), 4, 1, 4), PlaceStatus::NoSupport);
+    EXPECT_EQ(storage.getListContainers().size(), 1);
+    EXPECT_THROW(storage.addContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 2, 2, 1), std::invalid_argument);
+
+    storage.addExternalCheckFunction(checkCheker);
+    ContainerId id;
+    EXPECT_EQ(storage.tryPlace(std::make_shared<FragileRefragedContainer>("_", "Cargo B", 2, 1, 1, 23.5, 2.5, 24.5, 24.5), id), PlaceStatus::Rejected);
+    // Бросающий вызов выпускает наружу исключение самой проверки
+    try{
+        storage.addContainer(std::make_shared<FragileRefragedContainer>("_", "Cargo B", 2, 1, 1, 23.5, 2.5, 24.5, 24.5), 10, 10, 1);
+        FAIL();
+    }catch(std::invalid_argument& e){
+        EXPECT_STREQ(e.what(), "Proved");
+    }
+    // Копии склада проверяют так же, как он сам
+    Storage copy(storage);
+    EXPECT_EQ(copy.tryAdd(std::make_shared<RefragedContainer>("_", "Cargo A", 2, 2, 1, 21.2, 1.1, 13.1), 10, 10, 1), PlaceStatus::TooHot);
+    Storage assigned(1, 20, 20, 10, 20.0);
+    assigned = storage;
+    EXPECT_EQ(assigned.tryAdd(std::make_shared<FragileRefragedContainer>("_", "Cargo B", 2, 1, 1, 23.5, 2.5, 24.5, 24.5), 10, 10, 1), PlaceStatus::Rejected);
+    EXPECT_FALSE(id.valid());
+    EXPECT_EQ(storage.tryPlace(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), id), PlaceStatus::Ok);
+    EXPECT_EQ(id.toString(), "1_1_4");
+}
+
 TEST(StorageTest, RemoveHard){
     Storage st =  Storage(1, 100, 100, 32, 23.4);
     std::shared_ptr<IContainer> container1 = std::make_shared<Container>("_", "Cargo B", 6, 6, 1, 23.5, 2.5);
@@ -363,6 +679,658 @@ TEST(OctreeTest, TestIterator){
 }
 
 
+ContainerPosition<int> makePosition(int x, int y, int z, int l, int w, int h){
+    return ContainerPosition<int>(Point<int>(x, y, z), Point<int>(x, y, z + h), Point<int>(x + l, y, z), Point<int>(x + l, y, z + h),
+                                  Point<int>(x + l, y + w, z), Point<int>(x + l, y + w, z + h), Point<int>(x, y + w, z), Point<int>(x, y + w, z + h));
+}
+
+
+TEST(OctreeTest, ArenaReusesCollapsedBlocks){
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    std::vector<std::pair<int, int>> places = {{1, 1}, {4, 1}, {7, 1}, {10, 1}, {1, 4}};
+    for(auto& p : places){
+        auto pos = makePosition(p.first, p.second, 1, 1, 1, 1);
+        EXPECT_TRUE(tree.push(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), pos));
+    }
+    EXPECT_FALSE(tree.getRoot()->isLeaf());
+    EXPECT_EQ(tree.allocatedBlocks(), 1);
+    for(auto& p : places){
+        EXPECT_TRUE(tree.remove(std::to_string(p.first) + "_" + std::to_string(p.second) + "_1"));
+    }
+    EXPECT_TRUE(tree.getRoot()->isLeaf());
+    EXPECT_EQ(tree.freeBlocks(), 1);
+    for(auto& p : places){
+        auto pos = makePosition(p.first, p.second, 1, 1, 1, 1);
+        tree.push(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), pos);
+    }
+    EXPECT_EQ(tree.allocatedBlocks(), 1);
+    EXPECT_EQ(tree.freeBlocks(), 0);
+    EXPECT_EQ(tree.searchDepth().size(), 5);
+}
+
+
+TEST(OctreeTest, CompactEntriesRoundTrip){
+    using Tree = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>;
+    Tree tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    auto pos = makePosition(2, 3, 4, 5, 6, 7);
+    tree.push(std::make_shared<Container>("_", "Cargo A", 5, 6, 7, 21.2, 1.1), pos);
+    auto& con = tree.getRoot()->con;
+    ASSERT_EQ(con.size(), 1);
+    EXPECT_EQ(con.minX[0], 2);
+    EXPECT_EQ(con.maxZ[0], 11);
+    EXPECT_TRUE(Tree::toPosition(con.box(0)) == pos);
+    auto found = tree.findI("2_3_4");
+    ASSERT_NE(found.second, nullptr);
+    EXPECT_TRUE(found.first == pos);
+}
+
+
+TEST(OctreeTest, IdIndexFollowsSplitAndMerge){
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    std::vector<std::string> ids;
+    for(int x = 1; x < 30; x += 3){
+        for(int y = 1; y < 30; y += 9){
+            auto pos = makePosition(x, y, 1, 1, 1, 1);
+            tree.push(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), pos);
+            ids.push_back(std::to_string(x) + "_" + std::to_string(y) + "_1");
+        }
+    }
+    EXPECT_EQ(tree.size(), ids.size());
+    for(size_t i = 0; i < ids.size(); i += 2){
+        EXPECT_TRUE(tree.remove(ids[i]));
+    }
+    for(size_t i = 0; i < ids.size(); ++i){
+        auto found = tree.findI(ids[i]);
+        if(i % 2 == 0){
+            EXPECT_EQ(found.second, nullptr);
+            EXPECT_EQ(tree.search(ids[i]), nullptr);
+        }else{
+            ASSERT_NE(found.second, nullptr);
+            EXPECT_EQ(std::to_string(found.first.LLDown.x) + "_" + std::to_string(found.first.LLDown.y) + "_1", ids[i]);
+        }
+    }
+    EXPECT_THROW(tree.findI("1_x_1"), std::invalid_argument);
+}
+
+
+TEST(OctreeTest, QueryBoxVisitsOnlyIntersecting){
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    for(int x = 1; x < 30; x += 4){
+        for(int y = 1; y < 30; y += 4){
+            auto pos = makePosition(x, y, 1, 2, 2, 2);
+            tree.push(std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1), pos);
+        }
+    }
+    auto hits = tree.queryBox(BoundingBox<int>(Point<int>(3, 3, 0), Point<int>(9, 5, 0)));
+    EXPECT_TRUE(hits.empty());
+    hits = tree.queryBox(BoundingBox<int>(Point<int>(3, 3, 1), Point<int>(9, 5, 1)));
+    EXPECT_EQ(hits.size(), 6);
+    for(auto& hit : hits){
+        EXPECT_LE(hit.first.LLDown.x, 9);
+        EXPECT_GE(hit.first.RRUp.x, 3);
+    }
+    size_t visited = 0;
+    tree.queryBox(BoundingBox<int>(Point<int>(0, 0, 0), Point<int>(31, 31, 31)), [&visited](const BoundingBox<int>&, const std::shared_ptr<IContainer>&){
+        ++visited;
+        return visited < 3;
+    });
+    EXPECT_EQ(visited, 3);
+}
+
+
+TEST(OctreeTest, SearchInsertCollision){
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    for(int x = 1; x < 30; x += 4){
+        auto pos = makePosition(x, 1, 1, 2, 2, 2);
+        tree.push(std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1), pos);
+    }
+    auto container = std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1);
+    EXPECT_EQ(tree.SearchInsert(container, makePosition(3, 3, 1, 1, 1, 1)), nullptr);
+    EXPECT_EQ(tree.SearchInsert(container, makePosition(31, 5, 1, 1, 1, 1)), nullptr);
+    EXPECT_NE(tree.SearchInsert(container, makePosition(4, 4, 1, 1, 1, 1)), nullptr);
+    auto target = tree.SearchInsert(container, makePosition(1, 20, 20, 1, 1, 1));
+    ASSERT_NE(target, nullptr);
+    EXPECT_TRUE(target->isLeaf());
+}
+
+
+TEST(OctreeTest, BulkLoad){
+    using Tree = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>;
+    std::vector<std::pair<BoundingBox<int>, std::shared_ptr<IContainer>>> entries;
+    for(int x = 1; x < 64; x += 4){
+        for(int y = 1; y < 64; y += 4){
+            for(int z = 1; z < 72; z += 4){
+                entries.emplace_back(Tree::toBox(makePosition(x, y, z, 2, 2, 2)), std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1));
+            }
+        }
+    }
+    size_t count = entries.size();
+    ASSERT_GE(count, Tree::ParallelBuildThreshold);
+    ThreadPool pool(2);
+    Tree tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(64, 64, 80)), 4, std::move(entries), &pool);
+    EXPECT_EQ(tree.size(), count);
+    EXPECT_EQ(tree.searchDepth().size(), count);
+    EXPECT_NE(tree.search(ContainerId(33, 17, 41)), nullptr);
+    EXPECT_EQ(tree.findI(ContainerId(33, 17, 41)).first.LLDown.z, 41);
+    EXPECT_EQ(tree.queryBox(BoundingBox<int>(Point<int>(0, 0, 0), Point<int>(8, 8, 8))).size(), 8);
+    auto container = std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1);
+    EXPECT_EQ(tree.SearchInsert(container, makePosition(2, 2, 2, 1, 1, 1)), nullptr);
+    EXPECT_NE(tree.SearchInsert(container, makePosition(4, 4, 74, 1, 1, 1)), nullptr);
+    // После перемещения корень переезжает вместе с деревом
+    Tree moved(std::move(tree));
+    EXPECT_EQ(tree.getRoot(), nullptr);
+    EXPECT_EQ(moved.findI(ContainerId(33, 17, 41)).first.LLDown.z, 41);
+    tree = std::move(moved);
+    EXPECT_EQ(moved.getRoot(), nullptr);
+    EXPECT_EQ(tree.searchDepth().size(), count);
+
+    std::vector<std::pair<BoundingBox<int>, std::shared_ptr<IContainer>>> outside;
+    outside.emplace_back(Tree::toBox(makePosition(60, 60, 60, 4, 4, 4)), container);
+    EXPECT_THROW(Tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(64, 64, 64)), 4, std::move(outside)), std::invalid_argument);
+}
+
+
+TEST(OctreeTest, LooseLayoutPushesStraddlingDown){
+    BoundingBox<int> bound(Point<int>(-1, -1, -1), Point<int>(64, 64, 64));
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tight(bound, 4);
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>, LooseLayout<>> loose(bound, 4);
+    // Все контейнеры пересекают среднюю плоскость x = 31
+    for(int y = 1; y < 60; y += 3){
+        for(int z = 1; z < 60; z += 3){
+            auto pos = makePosition(30, y, z, 2, 2, 2);
+            tight.push(std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1), pos);
+            loose.push(std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1), pos);
+        }
+    }
+    auto tightDepth = tight.entriesPerDepth();
+    auto looseDepth = loose.entriesPerDepth();
+    ASSERT_EQ(looseDepth.size(), 5);
+    EXPECT_EQ(tightDepth[0], tight.size());
+    EXPECT_EQ(looseDepth[0], 0);
+    EXPECT_GT(looseDepth[4], 0);
+    BoundingBox<int> query(Point<int>(29, 10, 10), Point<int>(31, 20, 20));
+    EXPECT_EQ(tight.queryBox(query).size(), loose.queryBox(query).size());
+    auto container = std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1);
+    EXPECT_EQ(loose.SearchInsert(container, makePosition(31, 5, 5, 1, 1, 1)), nullptr);
+    EXPECT_NE(loose.SearchInsert(container, makePosition(40, 5, 5, 1, 1, 1)), nullptr);
+}
+
+
+TEST(OctreeTest, SplitPolicyHysteresis){
+    SplitPolicy<int> policy;
+    policy.leafCapacity = 4;
+    policy.mergeCapacity = 1;
+    Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), policy);
+    std::vector<std::string> ids = {"1_1_1", "20_1_1", "1_20_1", "20_20_1", "1_1_20"};
+    for(auto& id : ids){
+        auto key = ContainerId::parse(id);
+        auto pos = makePosition(key.getX(), key.getY(), key.getZ(), 1, 1, 1);
+        tree.push(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), pos);
+    }
+    EXPECT_FALSE(tree.getRoot()->isLeaf());
+    for(size_t i = 0; i < 3; ++i){
+        EXPECT_TRUE(tree.remove(ids[i]));
+    }
+    EXPECT_FALSE(tree.getRoot()->isLeaf());
+    EXPECT_TRUE(tree.remove(ids[3]));
+    EXPECT_TRUE(tree.getRoot()->isLeaf());
+    EXPECT_EQ(tree.getRoot()->con.size(), 1);
+    EXPECT_NE(tree.search(ids[4]), nullptr);
+
+    policy.mergeCapacity = 4;
+    EXPECT_THROW(Storage(1, 33, 32, 16, 20.0, policy), std::invalid_argument);
+    policy.mergeCapacity = 2;
+    policy.leafCapacity = 8;
+    Storage storage(1, 33, 32, 16, 20.0, policy);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 1, 1, 1);
+    Storage copy = storage;
+    EXPECT_EQ(copy.getSplitPolicy().leafCapacity, 8);
+    EXPECT_EQ(copy.getListContainers().size(), 1);
+}
+
+
+TEST(OctreeTest, EntryRange){
+    using Tree = Octree<int, std::shared_ptr<IContainer>, ContainerPosition<int>>;
+    static_assert(std::ranges::forward_range<Tree::EntryRange>);
+    static_assert(std::ranges::view<Tree::EntryRange>);
+    Tree tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(32, 32, 32)), 3);
+    EXPECT_TRUE(tree.entries().empty());
+    for(int x = 1; x < 30; x += 3){
+        for(int y = 1; y < 30; y += 7){
+            auto pos = makePosition(x, y, 1, 1, 1, 1);
+            tree.push(std::make_shared<Container>("_", "Cargo A", 1, 1, 1, 21.2, 1.1), pos);
+        }
+    }
+    auto copy = tree.searchDepth();
+    ASSERT_EQ(static_cast<size_t>(std::ranges::distance(tree.entries())), copy.size());
+    size_t i = 0;
+    for(auto entry : tree.entries()){
+        EXPECT_TRUE(entry.position() == copy[i].first);
+        EXPECT_EQ(entry.item, copy[i].second);
+        ++i;
+    }
+    auto range = tree.entries();
+    auto high = std::ranges::find_if(range, [](auto entry){ return entry.box.min.y == 22; });
+    ASSERT_NE(high, range.end());
+    EXPECT_EQ((*high).box.min.y, 22);
+    size_t visited = 0;
+    tree.forEachEntry([&visited](const BoundingBox<int>&, const std::shared_ptr<IContainer>&){
+        return ++visited < 5;
+    });
+    EXPECT_EQ(visited, 5);
+    size_t nodes = 0;
+    for(auto it = tree.begin(); it != tree.end(); ++it){
+        ++nodes;
+    }
+    EXPECT_EQ(nodes, 1 + 8 * tree.allocatedBlocks());
+
+    Storage storage(1, 10, 10, 10, 20.0);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 2, 2, 1, 21.2, 1.1), 1, 1, 1);
+    std::ostringstream out;
+    storage.getInfo(out);
+    EXPECT_EQ(out.str(), storage.getInfo());
+    EXPECT_EQ(out.str(), "1_1_1 2 x 2 x 1 Default Container\n");
+}
+
+
+TEST(ThreadPoolTest, NestedTasksAndShutdown){
+    ThreadPool pool(1);
+    EXPECT_EQ(pool.size(), 1);
+    ThreadPool::TaskGroup top(pool);
+    auto outer = top.submit([&pool](){
+        ThreadPool::TaskGroup group(pool);
+        std::vector<std::future<int>> inner;
+        for(int i = 1; i <= 4; ++i){
+            inner.push_back(group.submit([i](){ return i * i; }));
+        }
+        group.wait();
+        int sum = 0;
+        for(auto& f : inner){
+            sum += f.get();
+        }
+        return sum;
+    });
+    // Чужая задача в очереди не выполняется ждущим группу
+    std::atomic<bool> release(false);
+    auto foreign = pool.submit([&release](){
+        while(!release){
+            std::this_thread::yield();
+        }
+        return 1;
+    });
+    top.wait();
+    EXPECT_EQ(outer.get(), 30);
+    release = true;
+    EXPECT_EQ(foreign.get(), 1);
+    ThreadPool::TaskGroup failingGroup(pool);
+    auto failing = failingGroup.submit([]() -> int { throw std::runtime_error("task failed"); });
+    failingGroup.wait();
+    EXPECT_THROW(failing.get(), std::runtime_error);
+    pool.shutdown();
+    EXPECT_THROW(pool.submit([](){ return 0; }), std::runtime_error);
+
+    auto shared = std::make_shared<ThreadPool>(2);
+    Terminal terminal(shared);
+    Storage* storage = new Storage(1, 10, 5, 3, 20.0);
+    terminal.add(1, storage);
+    EXPECT_EQ(storage->getThreadPool(), shared);
+    Storage copy = *storage;
+    EXPECT_EQ(copy.getThreadPool(), shared);
+}
+
+
+TEST(StorageTest, RegionWritersInParallel){
+    // Каждый поток ставит столбики в своей полосе пола и снимает их верхушки
+    Storage storage(1, 80, 20, 40, 20.0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&storage, t](){
+            int X = 1 + t * 20;
+            for(int i = 0; i < 30; ++i){
+                ContainerId id = storage.dropContainer(std::make_shared<Container>("_", "Cargo A", 5, 5, 2, 21.2, 1.1), X + (i % 2) * 8, 1);
+                if(i % 3 == 2){
+                    storage.removeContainer(id);
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    auto ids = storage.getListContainerIds();
+    EXPECT_EQ(ids.size(), 80);
+    for(auto& id : ids){
+        EXPECT_EQ(storage.find(id).second->getKey(), id);
+        EXPECT_EQ((id.getZ() - 1) % 3, 0);
+        if(id.getZ() > 1){
+            EXPECT_EQ(storage.containersBelow(id).size(), 1);
+        }
+    }
+    // Проверка проходит по индексам, собранным параллельно
+    EXPECT_EQ(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 5, 5, 2, 21.2, 1.1), 1, 1, 1), PlaceStatus::NoPlace);
+}
+
+TEST(StorageTest, RegionWritersRaceForOnePlace){
+    Storage storage(1, 40, 40, 10, 20.0);
+    std::atomic<int> placed(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t){
+        threads.emplace_back([&storage, &placed](){
+            if(storage.tryAdd(std::make_shared<Container>("_", "Cargo A", 4, 4, 1, 21.2, 1.1), 3, 3, 1) == PlaceStatus::Ok){
+                ++placed;
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    EXPECT_EQ(placed.load(), 1);
+    EXPECT_EQ(storage.getListContainerIds().size(), 1);
+}
+
+TEST(StorageTest, PlacementLeases){
+    PlacementLeases leases;
+    BoundingBox<int> box(Point<int>(1, 1, 1), Point<int>(4, 4, 4));
+    {
+        auto lease = leases.acquire(box);
+        EXPECT_TRUE(static_cast<bool>(lease));
+        // Касание гранью тоже конфликт
+        EXPECT_FALSE(static_cast<bool>(leases.acquire(BoundingBox<int>(Point<int>(4, 1, 1), Point<int>(6, 4, 4)))));
+        EXPECT_TRUE(static_cast<bool>(leases.acquire(BoundingBox<int>(Point<int>(5, 1, 1), Point<int>(6, 4, 4)))));
+        EXPECT_TRUE(leases.leased(BoundingBox<int>(Point<int>(2, 2, 2), Point<int>(2, 2, 2))));
+        EXPECT_EQ(leases.size(), 1);
+    }
+    EXPECT_EQ(leases.size(), 0);
+    EXPECT_FALSE(leases.leased(box));
+    // Ожидание кончается освобождением аренды или отменой
+    uint64_t seen = leases.releases();
+    EXPECT_EQ(seen, 2);
+    auto lease = std::make_unique<PlacementLeases::Lease>(leases.acquire(box));
+    std::thread releaser([&lease](){ lease.reset(); });
+    leases.waitRelease(seen, std::stop_token());
+    releaser.join();
+    EXPECT_EQ(leases.releases(), seen + 1);
+    std::stop_source stop;
+    stop.request_stop();
+    leases.waitRelease(leases.releases(), stop.get_token());
+}
+
+TEST(StorageTest, ConcurrentAutomaticPlacement){
+    Storage storage(1, 40, 40, 10, 20.0);
+    storage.setThreadPool(std::make_shared<ThreadPool>(2));
+    std::atomic<int> placed(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&storage, &placed, t](){
+            for(int i = 0; i < 20; ++i){
+                ContainerId id;
+                PlacementStrategy strategy = t % 2 == 0 ? PlacementStrategy::FirstFit : PlacementStrategy::LowestHeight;
+                if(storage.tryPlace(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), id, strategy) == PlaceStatus::Ok){
+                    EXPECT_TRUE(id.valid());
+                    ++placed;
+                }
+            }
+        });
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    // Места хватает на всех: отказов из-за чужой аренды быть не должно
+    EXPECT_EQ(placed.load(), 80);
+    auto ids = storage.getListContainerIds();
+    EXPECT_EQ(ids.size(), 80);
+    for(auto& id : ids){
+        EXPECT_EQ(storage.find(id).second->getKey(), id);
+        if(id.getZ() > 1){
+            EXPECT_FALSE(storage.containersBelow(id).empty());
+        }
+    }
+}
+
+TEST(StorageTest, EpochReclamation){
+    PublishedIndex<ContainerPosition<int>, std::shared_ptr<IContainer>> index;
+    std::pair<ContainerPosition<int>, std::shared_ptr<IContainer>> result;
+    ContainerId id(1, 1, 1);
+    EXPECT_EQ(index.find(id, result), decltype(index)::Lookup::Off);
+    index.rebuild({});
+    EXPECT_EQ(index.find(id, result), decltype(index)::Lookup::Missing);
+    EpochDomain domain;
+    {
+        // Пока читатель держит эпоху, снятое с публикации не освобождается
+        EpochDomain::Guard guard(domain);
+        domain.retire(new int(1));
+        EXPECT_EQ(domain.collect(), 0);
+        EXPECT_EQ(domain.pending(), 1);
+    }
+    EXPECT_EQ(domain.collect(), 1);
+    EXPECT_EQ(domain.pending(), 0);
+    // Когда слоты кончились, читатель не ждёт, а остаётся незакреплённым
+    std::vector<std::unique_ptr<EpochDomain::Guard>> guards;
+    for(size_t i = 0; i < EpochDomain::Slots; ++i){
+        guards.push_back(std::make_unique<EpochDomain::Guard>(domain));
+        EXPECT_TRUE(guards.back()->pinned());
+    }
+    EXPECT_FALSE(EpochDomain::Guard(domain).pinned());
+    guards.pop_back();
+    EXPECT_TRUE(EpochDomain::Guard(domain).pinned());
+}
+
+TEST(StorageTest, ReadMostlyFind){
+    Storage storage(1, 60, 60, 10, 20.0);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 1, 1, 1);
+    storage.setReadMostly(true);
+    EXPECT_TRUE(storage.isReadMostly());
+    EXPECT_EQ(storage.find(ContainerId(1, 1, 1)).first.LLDown, Point<int>(1, 1, 1));
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> hits(0);
+    std::vector<std::thread> readers;
+    for(int r = 0; r < 3; ++r){
+        readers.emplace_back([&storage, &writing, &hits](){
+            while(writing){
+                for(int x = 1; x < 60; x += 5){
+                    try{
+                        auto item = storage.find(ContainerId(x, 10, 1));
+                        EXPECT_EQ(item.first.LLDown, Point<int>(x, 10, 1));
+                        ++hits;
+                    }catch(std::runtime_error&){
+                    }
+                }
+            }
+        });
+    }
+    for(int round = 0; round < 20; ++round){
+        for(int x = 1; x < 60; x += 5){
+            storage.addContainer(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), x, 10, 1);
+        }
+        for(int x = 1; x < 60; x += 5){
+            storage.removeContainer(ContainerId(x, 10, 1));
+        }
+    }
+    writing = false;
+    for(auto& reader : readers){
+        reader.join();
+    }
+    EXPECT_THROW(storage.find(ContainerId(6, 10, 1)), std::runtime_error);
+    // Копия склада индекс не наследует, но ищет так же
+    Storage copy(storage);
+    EXPECT_FALSE(copy.isReadMostly());
+    EXPECT_EQ(copy.find(ContainerId(1, 1, 1)).second->getKey(), ContainerId(1, 1, 1));
+    // Перемещение и поворот переписывают опубликованный индекс
+    storage.moveContainer(ContainerId(1, 1, 1), 30, 30, 1);
+    EXPECT_THROW(storage.find(ContainerId(1, 1, 1)), std::runtime_error);
+    EXPECT_EQ(storage.find(ContainerId(30, 30, 1)).first.LLDown, Point<int>(30, 30, 1));
+    storage.rotateContainer(ContainerId(30, 30, 1), 1);
+    EXPECT_EQ(storage.find(ContainerId(30, 30, 1)).second->getKey(), ContainerId(30, 30, 1));
+    EXPECT_EQ(storage.getListContainerIds().size(), 1);
+    storage.setReadMostly(false);
+    EXPECT_EQ(storage.find(ContainerId(30, 30, 1)).second->getKey(), ContainerId(30, 30, 1));
+}
+
+TEST(StorageTest, PersistentOctreeVersions){
+    PersistentOctree<int, std::shared_ptr<IContainer>> tree(BoundingBox<int>(Point<int>(-1, -1, -1), Point<int>(100, 100, 20)));
+    std::vector<BoundingBox<int>> boxes;
+    for(int x = 1; x < 95; x += 4){
+        for(int y = 1; y < 95; y += 4){
+            BoundingBox<int> box(Point<int>(x, y, 1), Point<int>(x + 2, y + 2, 3));
+            tree.insert(box, std::make_shared<Container>("_", "Cargo A", 2, 2, 2, 21.2, 1.1));
+            boxes.push_back(box);
+        }
+    }
+    auto before = tree;
+    EXPECT_TRUE(tree.remove(ContainerId(5, 5, 1)));
+    EXPECT_FALSE(tree.remove(ContainerId(5, 5, 1)));
+    tree.insert(BoundingBox<int>(Point<int>(5, 5, 5), Point<int>(7, 7, 7)), nullptr);
+    // Старая версия не изменилась, новая разделяет с ней всё, кроме пары путей
+    EXPECT_EQ(before.size(), boxes.size());
+    EXPECT_EQ(tree.size(), boxes.size());
+    EXPECT_NE(before.find(ContainerId(5, 5, 1)), nullptr);
+    EXPECT_EQ(tree.find(ContainerId(5, 5, 1)), nullptr);
+    EXPECT_NE(tree.find(ContainerId(5, 5, 5)), nullptr);
+    EXPECT_LE(tree.uniqueNodes(before), 2 * (SplitPolicy<int>().maxDepth + 1));
+    for(auto& box : boxes){
+        EXPECT_TRUE(before.collides(box));
+        EXPECT_EQ(tree.collides(box), !(box.min.x == 5 && box.min.y == 5));
+    }
+    EXPECT_FALSE(before.collides(BoundingBox<int>(Point<int>(4, 4, 1), Point<int>(4, 4, 1))));
+    // Пакетная сборка даёт то же содержимое
+    std::vector<PersistentOctree<int, std::shared_ptr<IContainer>>::Entry> entries;
+    before.forEachEntry([&entries](const BoundingBox<int>& box, const std::shared_ptr<IContainer>& item){
+        entries.push_back({box, item});
+    });
+    PersistentOctree<int, std::shared_ptr<IContainer>> bulk(before.bound(), SplitPolicy<int>(), entries);
+    EXPECT_EQ(bulk.size(), boxes.size());
+    for(auto& box : boxes){
+        EXPECT_NE(bulk.find(ContainerId(box.min.x, box.min.y, box.min.z)), nullptr);
+    }
+    EXPECT_TRUE(bulk.remove(ContainerId(5, 5, 1)));
+    EXPECT_FALSE(bulk.collides(BoundingBox<int>(Point<int>(5, 5, 1), Point<int>(5, 5, 1))));
+}
+
+TEST(StorageTest, StorageSnapshot){
+    Storage storage(1, 40, 40, 10, 20.0);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 1, 1, 1);
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 10, 1, 1);
+    StorageSnapshot report = storage.snapshot();
+    storage.removeContainer(ContainerId(10, 1, 1));
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 20, 1, 1);
+    // Отчёт видит склад на момент снимка
+    EXPECT_EQ(report.size(), 2);
+    EXPECT_EQ(report.find(ContainerId(10, 1, 1)).first.LLDown, Point<int>(10, 1, 1));
+    EXPECT_THROW(report.find(ContainerId(20, 1, 1)), std::runtime_error);
+    // Что если: меняется только снимок
+    StorageSnapshot whatIf = storage.snapshot();
+    EXPECT_EQ(whatIf.tryAdd(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 1, 1, 3), PlaceStatus::Ok);
+    EXPECT_EQ(whatIf.tryAdd(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 2, 2, 1), PlaceStatus::NoPlace);
+    EXPECT_EQ(whatIf.tryAdd(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 30, 30, 3), PlaceStatus::CantFly);
+    EXPECT_EQ(whatIf.tryAdd(std::make_shared<Container>("_", "Cargo A", 3, 3, 1, 21.2, 1.1), 38, 1, 1), PlaceStatus::NoPlace);
+    EXPECT_TRUE(whatIf.remove(ContainerId(20, 1, 1)));
+    EXPECT_EQ(whatIf.size(), 2);
+    EXPECT_EQ(storage.getListContainerIds().size(), 2);
+    EXPECT_EQ(storage.snapshot().getTree().uniqueNodes(whatIf.getTree()), 1);
+    // Перемещение и поворот переносят запись снимка, а не дублируют её
+    storage.addContainer(std::make_shared<Container>("_", "Cargo A", 2, 3, 1, 21.2, 1.1), 1, 1, 3);
+    storage.moveContainer(ContainerId(1, 1, 3), 30, 1, 1);
+    storage.rotateContainer(ContainerId(30, 1, 1), 1);
+    EXPECT_THROW(storage.moveContainer(ContainerId(30, 1, 1), 39, 1, 1), std::invalid_argument);
+    auto live = storage.getListContainerIds();
+    auto snapped = storage.snapshot().getListContainerIds();
+    std::sort(live.begin(), live.end());
+    std::sort(snapped.begin(), snapped.end());
+    EXPECT_EQ(snapped, live);
+    EXPECT_EQ(snapped.size(), 3);
+}
+
+TEST(StorageTest, ConcurrentReadersAndWriters){
+    Storage storage(1, 60, 60, 10, 20.0);
+    storage.setThreadPool(std::make_shared<ThreadPool>(2));
+    storage.setReadMostly(true);
+    storage.snapshot();
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> reads(0);
+    std::vector<std::thread> threads;
+    for(int w = 0; w < 3; ++w){
+        threads.emplace_back([&storage, w](){
+            std::mt19937 gen(w);
+            std::uniform_int_distribution<int> size(2, 8);
+            std::uniform_int_distribution<int> coord(1, 50);
+            for(int i = 0; i < 80; ++i){
+                if(i % 4 != 0){
+                    auto ids = storage.getListContainerIds();
+                    if(!ids.empty()){
+                        ContainerId id = ids[gen() % ids.size()];
+                        try{
+                            if(i % 4 == 1){
+                                storage.removeContainer(id);
+                            }else if(i % 4 == 2){
+                                storage.moveContainer(id, coord(gen), coord(gen), 1);
+                            }else{
+                                storage.rotateContainer(id, gen() % 6);
+                            }
+                        }catch(std::exception&){
+                        }
+                    }
+                }
+                if(i % 4 != 1){
+                    storage.addContainer(std::make_shared<Container>("_", "Cargo A", size(gen), size(gen), 1, 21.2, 1.1));
+                }
+            }
+        });
+    }
+    for(int r = 0; r < 4; ++r){
+        threads.emplace_back([&storage, &writing, &reads](){
+            while(writing){
+                for(auto& id : storage.getListContainerIds()){
+                    // Позиция копируется под блокировкой; сам контейнер писатель может уже переставить
+                    try{
+                        EXPECT_EQ(storage.find(id).first.LLDown, Point<int>(id.getX(), id.getY(), id.getZ()));
+                    }catch(std::runtime_error&){
+                    }
+                }
+                storage.getInfo();
+                storage.getListContainers();
+                storage.getALLcontainers();
+                storage.loadMargins();
+                ++reads;
+            }
+        });
+    }
+    for(int w = 0; w < 3; ++w){
+        threads[w].join();
+    }
+    writing = false;
+    for(size_t i = 3; i < threads.size(); ++i){
+        threads[i].join();
+    }
+    EXPECT_GT(reads.load(), 0);
+    auto ids = storage.getListContainerIds();
+    EXPECT_EQ(ids.size(), storage.getALLcontainers().size());
+    for(auto& id : ids){
+        EXPECT_EQ(storage.find(id).second->getKey(), id);
+        if(id.getZ() > 1){
+            EXPECT_FALSE(storage.containersBelow(id).empty());
+        }
+        // Рёбра графа взаимны, без дублей и только между стоящими контейнерами
+        auto above = storage.containersAbove(id);
+        EXPECT_EQ(std::set<ContainerId>(above.begin(), above.end()).size(), above.size());
+        for(auto& below : storage.containersBelow(id)){
+            auto up = storage.containersAbove(below);
+            EXPECT_EQ(std::count(up.begin(), up.end(), id), 1);
+            EXPECT_NO_THROW(storage.find(below));
+        }
+        EXPECT_NEAR(storage.loadCarried(id), 1.1 * storage.allContainersAbove(id).size(), 1e-9);
+    }
+    // Опубликованный индекс и снимок совпадают со складом
+    storage.setReadMostly(false);
+    for(auto& id : ids){
+        EXPECT_EQ(storage.find(id).second->getKey(), id);
+    }
+    auto snapped = storage.snapshot().getListContainerIds();
+    std::sort(ids.begin(), ids.end());
+    std::sort(snapped.begin(), snapped.end());
+    EXPECT_EQ(snapped, ids);
+}
+
+
 TEST(AddTerminalTest, Success) {
     Terminal terminal;
     Storage* storage =  new Storage(1, 2, 2, 3, 20.0);